@@ -0,0 +1,246 @@
+#pragma once
+
+#include "TimeFrame.h"
+
+#include <functional>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Latest right row of every id, the rows are kept in one contiguous vector indexed through the id map
+template<class IdBranchType, class TimeBranchType, class RowType>
+class LatestTable
+{
+public:
+   void update(IdBranchType id, TimeBranchType time, RowType&& row)
+   {
+      auto it = slots.find(id);
+      if(it == slots.end())
+      {
+         slots.emplace(id, rows.size());
+         times.push_back(time);
+         rows.push_back(std::move(row));
+      }
+      else
+      {
+         times[it->second] = time;
+         rows[it->second] = std::move(row);
+      }
+   }
+
+   // Slot of the id, -1 if no row was seen
+   long find(IdBranchType id) const
+   {
+      auto it = slots.find(id);
+      return it != slots.end() ? (long) it->second : -1;
+   }
+
+   TimeBranchType time(long slot) const
+   {
+      return times[slot];
+   }
+   const RowType& row(long slot) const
+   {
+      return rows[slot];
+   }
+
+   size_t size() const
+   {
+      return rows.size();
+   }
+
+private:
+   std::unordered_map<IdBranchType, size_t> slots;
+   std::vector<TimeBranchType> times;
+   std::vector<RowType> rows;
+};
+
+// As-of join of two time ordered streams: every left row is passed with the latest right row of the same id at or before its time,
+// e.g. trades with the quote in effect when they happened. Right rows are only kept as the latest row per id.
+// A right row older than the tolerance, or none at all, is passed as nullptr.
+//
+// AsOfJoin<Trade, TradeReader, Quote, QuoteReader> join;
+// join.addLeft(trades);
+// join.addRight(quotes);
+// join.setTolerance(T_Second);
+// join.setForEachJoined([&](int id, TimeNS time, const Trade& trade, TimeNS quoteTime, const Quote* quote){ ... });
+// join.run();
+template<class LeftRowType, class LeftRowReaderType, class RightRowType, class RightRowReaderType, class IdBranchType = int, class TimeBranchType = TimeNS>
+class AsOfJoin
+{
+public:
+   using LeftSource = TimeFrameSource<LeftRowType, IdBranchType, TimeBranchType>;
+   using RightSource = TimeFrameSource<RightRowType, IdBranchType, TimeBranchType>;
+
+   AsOfJoin()
+   {
+      idFilter = [](IdBranchType id){return true;};
+   }
+
+   void addLeft(TTree* tree, std::string idBranchName = "id", std::string timeBranchName = "time")
+   {
+      left.emplace_back(std::make_unique<TimeFrameTree<LeftRowType, LeftRowReaderType, IdBranchType, TimeBranchType>>(tree, idBranchName, timeBranchName));
+   }
+   void addLeft(std::unique_ptr<LeftSource> source)
+   {
+      left.emplace_back(std::move(source));
+   }
+   void addLeftNative(std::string path)
+   {
+      left.emplace_back(std::make_unique<NativeSource<LeftRowType, IdBranchType, TimeBranchType>>(path));
+   }
+
+   void addRight(TTree* tree, std::string idBranchName = "id", std::string timeBranchName = "time")
+   {
+      right.emplace_back(std::make_unique<TimeFrameTree<RightRowType, RightRowReaderType, IdBranchType, TimeBranchType>>(tree, idBranchName, timeBranchName));
+   }
+   void addRight(std::unique_ptr<RightSource> source)
+   {
+      right.emplace_back(std::move(source));
+   }
+   void addRightNative(std::string path)
+   {
+      right.emplace_back(std::make_unique<NativeSource<RightRowType, IdBranchType, TimeBranchType>>(path));
+   }
+
+   void setForEachJoined(std::function<void(IdBranchType, TimeBranchType, const LeftRowType&, TimeBranchType, const RightRowType*)> func)
+   {
+      forEachJoined = func;
+   }
+
+   // Right rows more than tolerance before the left row do not match, negative for no limit
+   void setTolerance(TimeBranchType t)
+   {
+      tolerance = t;
+   }
+
+   void setIdFilter(std::function<bool(IdBranchType)> func)
+   {
+      idFilter = func;
+   }
+
+   // Left rows with from <= time < till are joined, right rows are read from the tolerance before from
+   void setTimeRange(TimeBranchType from, TimeBranchType till)
+   {
+      timeFrom = from;
+      timeTill = till;
+   }
+
+   void run()
+   {
+      if(!forEachJoined)
+      {
+         throw std::runtime_error("No handler for the joined rows set");
+      }
+
+      auto preFilterCallback = [&](){
+         entriesProcessed++;
+      };
+
+      TimeBranchType rightFrom = std::numeric_limits<TimeBranchType>::lowest();
+      if(tolerance >= 0 && timeFrom != std::numeric_limits<TimeBranchType>::lowest() && std::numeric_limits<TimeBranchType>::lowest() + tolerance < timeFrom)
+      {
+         rightFrom = timeFrom - tolerance;
+      }
+
+      for(auto& source : left)
+      {
+         source->timeFrom = timeFrom;
+         source->prepareFirst(idFilter, preFilterCallback);
+      }
+      for(auto& source : right)
+      {
+         source->timeFrom = rightFrom;
+         source->prepareFirst(idFilter, preFilterCallback);
+      }
+
+      while(true)
+      {
+         int l = earliest(left);
+         if(l == -1 || left[l]->time >= timeTill)
+         {
+            break;
+         }
+
+         IdBranchType id = left[l]->id;
+         TimeBranchType time = left[l]->time;
+
+         // Right rows at the time of the left row are in effect for it
+         while(true)
+         {
+            int r = earliest(right);
+            if(r == -1 || right[r]->time > time)
+            {
+               break;
+            }
+
+            RightRowType row = right[r]->readRow();
+            detachRow(row);
+            latest.update(right[r]->id, right[r]->time, std::move(row));
+            right[r]->prepareNext(idFilter, preFilterCallback);
+         }
+
+         LeftRowType row = left[l]->readRow();
+
+         long slot = latest.find(id);
+         if(slot != -1 && (tolerance < 0 || time - latest.time(slot) <= tolerance))
+         {
+            rowsMatched++;
+            forEachJoined(id, time, row, latest.time(slot), &latest.row(slot));
+         }
+         else
+         {
+            rowsUnmatched++;
+            forEachJoined(id, time, row, TimeBranchType(), nullptr);
+         }
+
+         left[l]->prepareNext(idFilter, preFilterCallback);
+      }
+   }
+
+   long long getRowsMatched()
+   {
+      return rowsMatched;
+   }
+   long long getRowsUnmatched()
+   {
+      return rowsUnmatched;
+   }
+   long long getEntriesProcessed()
+   {
+      return entriesProcessed;
+   }
+
+private:
+   // Source with the earliest next row, -1 if all are at their end
+   template<class SourceType>
+   static int earliest(const std::vector<std::unique_ptr<SourceType>>& sources)
+   {
+      int index = -1;
+      for(int i=0;i<sources.size();i++)
+      {
+         if(sources[i]->hasNewRow && (index == -1 || sources[i]->time < sources[index]->time))
+         {
+            index = i;
+         }
+      }
+      return index;
+   }
+
+   std::vector<std::unique_ptr<LeftSource>> left;
+   std::vector<std::unique_ptr<RightSource>> right;
+
+   std::function<void(IdBranchType, TimeBranchType, const LeftRowType&, TimeBranchType, const RightRowType*)> forEachJoined;
+   std::function<bool(IdBranchType)> idFilter;
+
+   TimeBranchType tolerance = -1;
+   TimeBranchType timeFrom = std::numeric_limits<TimeBranchType>::lowest();
+   TimeBranchType timeTill = std::numeric_limits<TimeBranchType>::max();
+
+   LatestTable<IdBranchType, TimeBranchType, RightRowType> latest;
+
+   long long rowsMatched = 0;
+   long long rowsUnmatched = 0;
+   long long entriesProcessed = 0;
+};
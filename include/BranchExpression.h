@@ -0,0 +1,170 @@
+#pragma once
+
+#include <map>
+#include <regex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "TInterpreter.h"
+#include "TTree.h"
+#include "TBranch.h"
+#include "TLeaf.h"
+#include "TTreeReader.h"
+
+// Predicate given as a C++ expression over branch names, e.g. "x > 1.5 && id == 3".
+// The expression is compiled once by the ROOT interpreter into a native function that reads only the branches it names,
+// through its own reader values on the reader of the tree, so the branches of the row are not read to evaluate it.
+class BranchExpression
+{
+public:
+   BranchExpression(TTree* tree, TTreeReader& reader, const std::string& expression)
+   {
+      std::string members;
+      std::string initializers;
+      std::string locals;
+      std::string key = expression;
+
+      for(const auto& branchName : findBranches(tree, expression))
+      {
+         std::string type = branchType(tree, branchName);
+
+         members += "   TTreeReaderValue<" + type + "> " + branchName + ";\n";
+         initializers += std::string(initializers.size() == 0 ? " : " : ", ") + branchName + "(reader, \"" + branchName + "\")";
+         locals += "   const auto& " + branchName + " = *expressionValues." + branchName + ";\n";
+         key += ";" + branchName + ":" + type;
+
+         branches.push_back(branchName);
+      }
+
+      auto it = compiled().find(key);
+      if(it == compiled().end())
+      {
+         it = compiled().emplace(key, compile(expression, members, initializers, locals)).first;
+      }
+
+      functions = it->second;
+      values = functions.create(&reader);
+   }
+
+   ~BranchExpression()
+   {
+      functions.destroy(values);
+   }
+
+   BranchExpression(const BranchExpression&) = delete;
+   BranchExpression& operator=(const BranchExpression&) = delete;
+
+   // Evaluates the expression on the current entry of the reader
+   bool operator()() const
+   {
+      return functions.evaluate(values);
+   }
+
+   const std::vector<std::string>& getBranches() const
+   {
+      return branches;
+   }
+
+private:
+   struct Functions
+   {
+      void* (*create)(TTreeReader*) = nullptr;
+      bool (*evaluate)(void*) = nullptr;
+      void (*destroy)(void*) = nullptr;
+   };
+
+   // Expressions with the same text on branches of the same types share their compiled code
+   static std::map<std::string, Functions>& compiled()
+   {
+      static std::map<std::string, Functions> functions;
+      return functions;
+   }
+
+   static Functions compile(const std::string& expression, const std::string& members, const std::string& initializers, const std::string& locals)
+   {
+      std::string name = "Expression" + std::to_string(compiled().size());
+
+      std::string code =
+         "#include \"TTreeReader.h\"\n"
+         "#include \"TTreeReaderValue.h\"\n"
+         "namespace TimeFrameExpressions {\n"
+         "struct " + name + "\n{\n"
+         "   " + name + "(TTreeReader& reader)" + initializers + " {}\n" +
+         members +
+         "};\n"
+         "void* create" + name + "(TTreeReader* reader) { return new " + name + "(*reader); }\n"
+         "void destroy" + name + "(void* p) { delete (" + name + "*) p; }\n"
+         "bool evaluate" + name + "(void* p)\n{\n"
+         "   auto& expressionValues = *(" + name + "*) p;\n" +
+         locals +
+         "   return (" + expression + ");\n"
+         "}\n"
+         "}\n";
+
+      if(!gInterpreter->Declare(code.c_str()))
+      {
+         throw std::runtime_error("Cannot compile expression: " + expression);
+      }
+
+      Functions functions;
+      functions.create = (void* (*)(TTreeReader*)) gInterpreter->Calc(("(long) &TimeFrameExpressions::create" + name).c_str());
+      functions.destroy = (void (*)(void*)) gInterpreter->Calc(("(long) &TimeFrameExpressions::destroy" + name).c_str());
+      functions.evaluate = (bool (*)(void*)) gInterpreter->Calc(("(long) &TimeFrameExpressions::evaluate" + name).c_str());
+
+      if(!functions.create || !functions.destroy || !functions.evaluate)
+      {
+         throw std::runtime_error("Cannot load compiled expression: " + expression);
+      }
+
+      return functions;
+   }
+
+   // Identifiers of the expression that name a branch, members accessed with . -> or :: are not branches
+   static std::vector<std::string> findBranches(TTree* tree, const std::string& expression)
+   {
+      std::set<std::string> branchNames;
+      TObjArray* list = tree->GetListOfBranches();
+      for(int i = 0; list != nullptr && i < list->GetEntries(); i++)
+      {
+         branchNames.insert(list->At(i)->GetName());
+      }
+
+      std::set<std::string> found;
+      const std::regex identifier("[A-Za-z_][A-Za-z0-9_]*");
+      for(auto it = std::sregex_iterator(expression.begin(), expression.end(), identifier); it != std::sregex_iterator(); it++)
+      {
+         size_t position = it->position();
+         bool member = (position >= 1 && expression[position - 1] == '.')
+            || (position >= 2 && (expression.compare(position - 2, 2, "->") == 0 || expression.compare(position - 2, 2, "::") == 0));
+
+         if(!member && branchNames.count(it->str()) > 0)
+         {
+            found.insert(it->str());
+         }
+      }
+
+      return std::vector<std::string>(found.begin(), found.end());
+   }
+
+   static std::string branchType(TTree* tree, const std::string& branchName)
+   {
+      TBranch* branch = tree->GetBranch(branchName.c_str());
+      TLeaf* leaf = branch != nullptr ? branch->GetLeaf(branchName.c_str()) : nullptr;
+      if(leaf == nullptr && branch != nullptr && branch->GetListOfLeaves() != nullptr && branch->GetListOfLeaves()->GetEntries() == 1)
+      {
+         leaf = (TLeaf*) branch->GetListOfLeaves()->At(0);
+      }
+      if(leaf == nullptr)
+      {
+         throw std::runtime_error("Expressions only support branches of a single value: " + branchName);
+      }
+
+      return leaf->GetTypeName();
+   }
+
+   std::vector<std::string> branches;
+
+   Functions functions;
+   void* values = nullptr;
+};
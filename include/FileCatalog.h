@@ -0,0 +1,479 @@
+#pragma once
+
+#include "TChainFactory.h"
+#include "TTreeReader.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <set>
+#include <unordered_set>
+
+// Compact summary of the ids present in a file, false positives are possible but no false negatives.
+// Sized for the number of ids of its file, about 10 bits per id with 7 hashes keep false positives below 1%.
+struct IdBloomFilter
+{
+   static constexpr int BitsPerId = 10;
+   static constexpr int Hashes = 7;
+
+   IdBloomFilter(size_t numberIds = 0)
+   :  words(std::max<size_t>(1, (numberIds * BitsPerId + 63) / 64))
+   {
+
+   }
+
+   template<class IdBranchType>
+   void add(const IdBranchType& id)
+   {
+      uint64_t h = mix(std::hash<IdBranchType>()(id));
+      for(int k = 0; k < Hashes; k++)
+      {
+         uint64_t bit = bitOf(h, k);
+         words[bit / 64] |= 1ULL << (bit % 64);
+      }
+   }
+
+   template<class IdBranchType>
+   bool mightContain(const IdBranchType& id) const
+   {
+      uint64_t h = mix(std::hash<IdBranchType>()(id));
+      for(int k = 0; k < Hashes; k++)
+      {
+         uint64_t bit = bitOf(h, k);
+         if((words[bit / 64] & (1ULL << (bit % 64))) == 0)
+         {
+            return false;
+         }
+      }
+      return true;
+   }
+
+   std::vector<uint64_t> words;
+
+private:
+   // Double hashing on both halves of a mixed hash
+   uint64_t bitOf(uint64_t h, int k) const
+   {
+      return ((h & 0xffffffff) + k * (h >> 32)) % (words.size() * 64);
+   }
+
+   // splitmix64 finalizer, std::hash of integers is the identity in most implementations
+   static uint64_t mix(uint64_t x)
+   {
+      x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+      return x ^ (x >> 31);
+   }
+};
+
+template<class TimeBranchType = TimeNS>
+struct Templated_CatalogEntry
+{
+   std::string path;
+   long long fileSize = 0;
+   long long modified = 0;
+
+   long entries = 0;
+   TimeBranchType minTime = TimeBranchType();
+   TimeBranchType maxTime = TimeBranchType();
+   TimeBranchType firstTime = TimeBranchType();
+   TimeBranchType lastTime = TimeBranchType();
+
+   std::vector<long long> clusters; // First entry of every cluster, e.g. to seek within the file
+   IdBloomFilter ids;
+};
+
+// Persistent per file summary of a data directory, used to open only the files that can contribute to a run.
+// Paths are stored relative to the directory of the catalog file, so the catalog works from any working directory
+// and moves along with its data.
+template<class IdBranchType = int, class TimeBranchType = TimeNS>
+class FileCatalog
+{
+public:
+   using CatalogEntry = Templated_CatalogEntry<TimeBranchType>;
+   using ChainFile = Templated_ChainFile<TimeBranchType>;
+
+   FileCatalog(std::string catalogPath, std::string treeName = "messages", std::string idBranchName = "id", std::string timeBranchName = "time")
+   :  catalogPath(catalogPath), treeName(treeName), idBranchName(idBranchName), timeBranchName(timeBranchName)
+   {
+      if(std::filesystem::exists(catalogPath))
+      {
+         load();
+      }
+   }
+
+   // Adds new and changed files below the directory and forgets files that are gone, then saves the catalog
+   void update(std::string directory, std::string regexStr = ".*", bool recursive = true, int threads = 0)
+   {
+      auto files = findFiles(directory, regexStr, recursive, threads);
+      for(auto& file : files)
+      {
+         file = std::filesystem::absolute(file).lexically_normal().string();
+      }
+
+      std::map<std::string, size_t> known;
+      for(size_t i = 0; i < entries.size(); i++)
+      {
+         known[entries[i].path] = i;
+      }
+
+      std::vector<CatalogEntry> updated;
+      std::vector<std::string> changed;
+      std::set<std::string> found;
+
+      for(auto& file : files)
+      {
+         found.insert(file);
+
+         auto it = known.find(file);
+         if(it != known.end() && entries[it->second].fileSize == fileSize(file) && entries[it->second].modified == modified(file))
+         {
+            updated.push_back(entries[it->second]);
+         }
+         else
+         {
+            changed.push_back(file);
+         }
+      }
+
+      // Entries outside the scanned directory are kept as they are
+      for(auto& entry : entries)
+      {
+         if(found.count(entry.path) == 0 && !isWithin(entry.path, directory))
+         {
+            updated.push_back(entry);
+         }
+      }
+
+      auto scanned = scan(changed, threads);
+      updated.insert(updated.end(), scanned.begin(), scanned.end());
+
+      std::sort(updated.begin(), updated.end(), [](const CatalogEntry& a, const CatalogEntry& b)
+      {
+         return a.firstTime < b.firstTime;
+      });
+
+      std::cout << "Catalog " << catalogPath << ": " << updated.size() << " files, " << scanned.size() << " scanned\n";
+
+      entries = updated;
+      save();
+   }
+
+   // Files that can hold rows within [from, till] for at least one of the ids, all ids if the set is empty
+   std::vector<ChainFile> select(TimeBranchType from, TimeBranchType till, const std::set<IdBranchType>& ids = {}) const
+   {
+      std::vector<ChainFile> selected;
+
+      for(const auto& entry : entries)
+      {
+         if(entry.entries == 0 || entry.maxTime < from || till < entry.minTime)
+         {
+            continue;
+         }
+
+         bool hasId = ids.size() == 0;
+         for(const auto& id : ids)
+         {
+            if(entry.ids.mightContain(id))
+            {
+               hasId = true;
+               break;
+            }
+         }
+
+         if(hasId)
+         {
+            ChainFile chainFile;
+            chainFile.path = entry.path;
+            chainFile.entries = entry.entries;
+            chainFile.firstTime = entry.minTime;
+            chainFile.lastTime = entry.maxTime;
+            // Only the first and last times are known, a file not starting and ending at its extremes is out of order
+            chainFile.sorted = entry.firstTime == entry.minTime && entry.lastTime == entry.maxTime;
+            selected.push_back(chainFile);
+         }
+      }
+
+      return selected;
+   }
+
+   TChain* makeChain(TimeBranchType from, TimeBranchType till, const std::set<IdBranchType>& ids = {}) const
+   {
+      auto selected = select(from, till, ids);
+      std::cout << "Catalog selects " << selected.size() << " of " << entries.size() << " files\n";
+
+      return ::makeChain<TimeBranchType>(treeName, selected);
+   }
+
+   const std::vector<CatalogEntry>& getEntries() const
+   {
+      return entries;
+   }
+
+   const std::string& getTreeName() const
+   {
+      return treeName;
+   }
+   const std::string& getIdBranchName() const
+   {
+      return idBranchName;
+   }
+   const std::string& getTimeBranchName() const
+   {
+      return timeBranchName;
+   }
+
+   void save() const
+   {
+      std::string tmpPath = catalogPath + ".tmp";
+      std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+
+      out.write(Magic, sizeof(Magic));
+      writeString(out, treeName);
+      writeString(out, idBranchName);
+      writeString(out, timeBranchName);
+      writeValue(out, (uint64_t) entries.size());
+
+      auto base = catalogDirectory();
+      for(const auto& entry : entries)
+      {
+         writeString(out, std::filesystem::path(entry.path).lexically_relative(base).string());
+         writeValue(out, entry.fileSize);
+         writeValue(out, entry.modified);
+         writeValue(out, (int64_t) entry.entries);
+         writeValue(out, entry.minTime);
+         writeValue(out, entry.maxTime);
+         writeValue(out, entry.firstTime);
+         writeValue(out, entry.lastTime);
+         writeValue(out, (uint64_t) entry.clusters.size());
+         out.write((const char*) entry.clusters.data(), entry.clusters.size() * sizeof(long long));
+         writeValue(out, (uint64_t) entry.ids.words.size());
+         out.write((const char*) entry.ids.words.data(), entry.ids.words.size() * sizeof(uint64_t));
+      }
+
+      out.close();
+      if(!out)
+      {
+         throw std::runtime_error("Cannot write catalog " + catalogPath);
+      }
+
+      std::filesystem::rename(tmpPath, catalogPath);
+   }
+
+private:
+   void load()
+   {
+      std::ifstream in(catalogPath, std::ios::binary);
+
+      char magic[sizeof(Magic)];
+      in.read(magic, sizeof(magic));
+      if(!in || std::memcmp(magic, Magic, sizeof(Magic)) != 0)
+      {
+         throw std::runtime_error("Not a catalog file: " + catalogPath);
+      }
+
+      std::string storedTreeName = readString(in);
+      std::string storedIdBranchName = readString(in);
+      std::string storedTimeBranchName = readString(in);
+      if(storedTreeName != treeName || storedIdBranchName != idBranchName || storedTimeBranchName != timeBranchName)
+      {
+         throw std::runtime_error("Catalog " + catalogPath + " was built for tree " + storedTreeName);
+      }
+
+      uint64_t size = readValue<uint64_t>(in);
+      entries.resize(size);
+
+      auto base = catalogDirectory();
+      for(auto& entry : entries)
+      {
+         entry.path = (base / readString(in)).lexically_normal().string();
+         entry.fileSize = readValue<long long>(in);
+         entry.modified = readValue<long long>(in);
+         entry.entries = readValue<int64_t>(in);
+         entry.minTime = readValue<TimeBranchType>(in);
+         entry.maxTime = readValue<TimeBranchType>(in);
+         entry.firstTime = readValue<TimeBranchType>(in);
+         entry.lastTime = readValue<TimeBranchType>(in);
+         entry.clusters.resize(readValue<uint64_t>(in));
+         in.read((char*) entry.clusters.data(), entry.clusters.size() * sizeof(long long));
+         entry.ids.words.resize(readValue<uint64_t>(in));
+         in.read((char*) entry.ids.words.data(), entry.ids.words.size() * sizeof(uint64_t));
+      }
+
+      if(!in)
+      {
+         throw std::runtime_error("Catalog file is truncated: " + catalogPath);
+      }
+   }
+
+   // Reads the id and time branches of every file once, files are processed concurrently
+   std::vector<CatalogEntry> scan(const std::vector<std::string>& files, int threads)
+   {
+      ROOT::EnableThreadSafety();
+
+      std::vector<CatalogEntry> scanned(files.size());
+      std::vector<char> valid(files.size(), false);
+      std::atomic<size_t> next(0);
+
+      auto read = [&]()
+      {
+         size_t i;
+         while((i = next++) < files.size())
+         {
+            std::unique_ptr<TFile> file(TFile::Open(files[i].c_str(), "READ"));
+            if(!file || file->IsZombie())
+            {
+               continue;
+            }
+
+            TTree* tree = file->Get<TTree>(treeName.c_str());
+            if(tree == nullptr)
+            {
+               continue;
+            }
+
+            auto& entry = scanned[i];
+            entry.path = files[i];
+            entry.fileSize = fileSize(files[i]);
+            entry.modified = modified(files[i]);
+            entry.entries = tree->GetEntries();
+
+            auto clusterIterator = tree->GetClusterIterator(0);
+            long long clusterStart;
+            while((clusterStart = clusterIterator()) < entry.entries)
+            {
+               entry.clusters.push_back(clusterStart);
+            }
+
+            std::unordered_set<IdBranchType> ids;
+
+            TTreeReader reader(tree);
+            TTreeReaderValue<IdBranchType> id(reader, idBranchName.c_str());
+            TTreeReaderValue<TimeBranchType> time(reader, timeBranchName.c_str());
+
+            bool first = true;
+            while(reader.Next())
+            {
+               if(first)
+               {
+                  entry.minTime = *time;
+                  entry.maxTime = *time;
+                  entry.firstTime = *time;
+                  first = false;
+               }
+               entry.minTime = std::min(entry.minTime, *time);
+               entry.maxTime = std::max(entry.maxTime, *time);
+               entry.lastTime = *time;
+               ids.insert(*id);
+            }
+
+            entry.ids = IdBloomFilter(ids.size());
+            for(const auto& id : ids)
+            {
+               entry.ids.add(id);
+            }
+
+            valid[i] = true;
+         }
+      };
+
+      std::vector<std::thread> workers;
+      for(int i = 0; i < defaultNumberThreads(threads); i++)
+      {
+         workers.emplace_back(read);
+      }
+      for(auto& worker : workers)
+      {
+         worker.join();
+      }
+
+      std::vector<CatalogEntry> result;
+      for(size_t i = 0; i < files.size(); i++)
+      {
+         if(valid[i])
+         {
+            result.push_back(scanned[i]);
+         }
+         else
+         {
+            std::cout << "Skip file that cannot be read or has no tree " << treeName << ": " << files[i] << "\n";
+         }
+      }
+
+      return result;
+   }
+
+   // Compares whole path components, so data2/a.root is not within data, relative and absolute paths are compared as absolute
+   static bool isWithin(const std::string& path, const std::string& directory)
+   {
+      namespace fs = std::filesystem;
+
+      fs::path file = fs::absolute(path).lexically_normal();
+      fs::path dir = fs::absolute(directory).lexically_normal();
+      if(dir.filename().empty())
+      {
+         dir = dir.parent_path();
+      }
+
+      auto f = file.begin();
+      for(auto d = dir.begin(); d != dir.end(); d++, f++)
+      {
+         if(f == file.end() || *f != *d)
+         {
+            return false;
+         }
+      }
+      return true;
+   }
+
+   // Absolute, as the catalog file may be given relative to the working directory
+   std::filesystem::path catalogDirectory() const
+   {
+      return std::filesystem::absolute(catalogPath).lexically_normal().parent_path();
+   }
+
+   static long long fileSize(const std::string& path)
+   {
+      std::error_code error;
+      return std::filesystem::file_size(path, error);
+   }
+   static long long modified(const std::string& path)
+   {
+      std::error_code error;
+      return std::filesystem::last_write_time(path, error).time_since_epoch().count();
+   }
+
+   template<class T>
+   static void writeValue(std::ofstream& out, const T& value)
+   {
+      out.write((const char*) &value, sizeof(T));
+   }
+   template<class T>
+   static T readValue(std::ifstream& in)
+   {
+      T value;
+      in.read((char*) &value, sizeof(T));
+      return value;
+   }
+   static void writeString(std::ofstream& out, const std::string& s)
+   {
+      writeValue(out, (uint32_t) s.size());
+      out.write(s.data(), s.size());
+   }
+   static std::string readString(std::ifstream& in)
+   {
+      std::string s(readValue<uint32_t>(in), '\0');
+      in.read(s.data(), s.size());
+      return s;
+   }
+
+   static constexpr char Magic[8] = {'T', 'F', 'C', 'A', 'T', 'L', 'G', '2'};
+
+   std::string catalogPath;
+   std::string treeName;
+   std::string idBranchName;
+   std::string timeBranchName;
+
+   std::vector<CatalogEntry> entries;
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+
+#include "TTreeReader.h"
+
+// Column of a lazily read row: the branch is read on first access for the current entry and the value is kept.
+// A row of lazy columns is only valid until its reader moves on, unless it is detached before.
+//
+// struct LazyMessage
+// {
+//    LazyColumn<double> x;
+//    LazyColumn<double> y;
+//
+//    void detach() const
+//    {
+//       x.detach();
+//       y.detach();
+//    }
+// };
+//
+// The row reader returns { x, y } from its reader values, TimeFrame detaches a row as soon as it keeps it beyond the current entry.
+template<class T>
+class LazyColumn
+{
+public:
+   LazyColumn(TTreeReaderValue<T>& v)
+   :  value(&v)
+   {
+
+   }
+
+   const T& operator*() const
+   {
+      if(value != nullptr)
+      {
+         cache = **value;
+         value = nullptr;
+      }
+      return cache;
+   }
+   const T* operator->() const
+   {
+      return &**this;
+   }
+   operator const T&() const
+   {
+      return **this;
+   }
+
+   // Reads the value now, so it stays available after the reader moved to the next entry
+   void detach() const
+   {
+      **this;
+   }
+
+private:
+   mutable TTreeReaderValue<T>* value;
+   mutable T cache = T();
+};
+
+template<class RowType, class = void>
+struct HasDetach : std::false_type {};
+
+template<class RowType>
+struct HasDetach<RowType, std::void_t<decltype(std::declval<const RowType&>().detach())>> : std::true_type {};
+
+// Rows without lazy columns own their values already
+template<class RowType>
+void detachRow(const RowType& row)
+{
+   if constexpr (HasDetach<RowType>::value)
+   {
+      row.detach();
+   }
+}
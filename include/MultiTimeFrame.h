@@ -0,0 +1,233 @@
+#pragma once
+
+#include "TimeFrame.h"
+
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+// Index of a type in a list of types, a compile error if it is not in the list
+template<class T, class... Types>
+struct Templated_TypeIndex;
+
+template<class T, class... Rest>
+struct Templated_TypeIndex<T, T, Rest...> : std::integral_constant<size_t, 0> {};
+
+template<class T, class First, class... Rest>
+struct Templated_TypeIndex<T, First, Rest...> : std::integral_constant<size_t, 1 + Templated_TypeIndex<T, Rest...>::value> {};
+
+// Merges sources of different row types into one time ordered stream, e.g. trades, quotes and order events, in a single pass.
+// Every source has its own row type and reader, rows of equal times are passed in the order their sources were added.
+// Rows are dispatched to the handler of their type and to the handler of all types as a std::variant, both on the stack.
+//
+// MultiTimeFrame<int, TimeNS, Trade, Quote> frame;
+// frame.addChain<Trade, TradeReader>("trades", "data/", ".*Trades.*");
+// frame.addChain<Quote, QuoteReader>("quotes", "data/", ".*Quotes.*");
+// frame.setForEachRow<Trade>([&](int id, TimeNS time, const Trade& trade){ ... });
+// frame.setForEachRow<Quote>([&](int id, TimeNS time, const Quote& quote){ ... });
+// frame.run();
+template<class IdBranchType, class TimeBranchType, class... RowTypes>
+class MultiTimeFrame
+{
+public:
+   using Row = std::variant<RowTypes...>;
+
+   template<class RowType>
+   using Source = TimeFrameSource<RowType, IdBranchType, TimeBranchType>;
+
+   MultiTimeFrame()
+   {
+      idFilter = [](IdBranchType id){return true;};
+   }
+
+   template<class RowType, class RowReaderType>
+   void addTree(TTree* tree, std::string idBranchName = "id", std::string timeBranchName = "time")
+   {
+      addSource<RowType>(std::make_unique<TimeFrameTree<RowType, RowReaderType, IdBranchType, TimeBranchType>>(tree, idBranchName, timeBranchName));
+   }
+   // Files of a directory matching the regex on their full path, chained in the order of their first timestamp
+   template<class RowType, class RowReaderType>
+   void addChain(std::string treeName, std::string path, std::string regexStr = ".*", std::string idBranchName = "id", std::string timeBranchName = "time")
+   {
+      addTree<RowType, RowReaderType>(makeSortedChain<TimeBranchType>(treeName, path, regexStr, timeBranchName), idBranchName, timeBranchName);
+   }
+   template<class RowType>
+   void addNative(std::string path)
+   {
+      addSource<RowType>(std::make_unique<NativeSource<RowType, IdBranchType, TimeBranchType>>(path));
+   }
+   template<class RowType>
+   void addSource(std::unique_ptr<Source<RowType>> source)
+   {
+      sources.emplace_back(std::in_place_index<Templated_TypeIndex<RowType, RowTypes...>::value>, std::move(source));
+   }
+
+   template<class RowType>
+   void setForEachRow(std::function<void(IdBranchType, TimeBranchType, const RowType&)> func)
+   {
+      std::get<Templated_TypeIndex<RowType, RowTypes...>::value>(forEachRow) = func;
+   }
+
+   // Called for the rows of all types after the handler of their type
+   void setForEachVariant(std::function<void(IdBranchType, TimeBranchType, const Row&)> func)
+   {
+      forEachVariant = func;
+   }
+
+   void setIdFilter(std::function<bool(IdBranchType)> func)
+   {
+      idFilter = func;
+   }
+
+   // Rows with from <= time < till are passed
+   void setTimeRange(TimeBranchType from, TimeBranchType till)
+   {
+      timeFrom = from;
+      timeTill = till;
+   }
+
+   // Ends the run after the current row, may be called from the handlers
+   void stop()
+   {
+      stopped = true;
+   }
+
+   // False if looping was aborted by an error, the results are incomplete then
+   bool run()
+   {
+      try
+      {
+         bool anyHandler = forEachVariant != nullptr;
+         std::apply([&](auto&... handlers){ ((anyHandler = anyHandler || handlers != nullptr), ...); }, forEachRow);
+         if(!anyHandler)
+         {
+            throw std::runtime_error("No handler for the rows set");
+         }
+
+         stopped = false;
+
+         auto preFilterCallback = [&](){
+            entriesProcessed++;
+         };
+
+         times.assign(sources.size(), TimeBranchType());
+         active.assign(sources.size(), false);
+
+         for(int i=0;i<sources.size();i++)
+         {
+            std::visit([&](auto& source)
+            {
+               source->timeFrom = timeFrom;
+               source->prepareFirst(idFilter, preFilterCallback);
+            }, sources[i]);
+            updateCursor(i);
+         }
+
+         while(!stopped)
+         {
+            int s = earliest();
+            if(s == -1 || times[s] >= timeTill)
+            {
+               break;
+            }
+
+            std::visit([&](auto& source)
+            {
+               dispatch(source->id, source->time, source->readRow());
+               source->prepareNext(idFilter, preFilterCallback);
+            }, sources[s]);
+            updateCursor(s);
+         }
+
+         return true;
+      }
+      catch(std::out_of_range& error)
+      {
+         std::cout << "\n\n";
+
+         std::cout << "Out of range error thrown in MultiTimeFrame class while looping: " << error.what() << "\n";
+         std::cout << "Looping is aborted, execution is incomplete.\n";
+         return false;
+      }
+      catch(std::runtime_error& error)
+      {
+         std::cout << "\n\n";
+
+         std::cout << "Error thrown in MultiTimeFrame class while looping: " << error.what() << "\n";
+         std::cout << "Looping is aborted, execution is incomplete.\n";
+         return false;
+      }
+   }
+
+   template<class RowType>
+   long long getRowsProcessed()
+   {
+      return rowsProcessed[Templated_TypeIndex<RowType, RowTypes...>::value];
+   }
+   long long getEntriesProcessed()
+   {
+      return entriesProcessed;
+   }
+
+private:
+   template<class RowType>
+   void dispatch(IdBranchType id, TimeBranchType time, RowType&& row)
+   {
+      constexpr size_t index = Templated_TypeIndex<std::decay_t<RowType>, RowTypes...>::value;
+      rowsProcessed[index]++;
+
+      auto& handler = std::get<index>(forEachRow);
+      if(handler)
+      {
+         handler(id, time, row);
+      }
+      if(forEachVariant)
+      {
+         forEachVariant(id, time, Row(std::in_place_index<index>, std::move(row)));
+      }
+   }
+
+   // The time and state of every source are kept next to each other, so finding the earliest does not visit the sources
+   void updateCursor(int i)
+   {
+      std::visit([&](auto& source)
+      {
+         active[i] = source->hasNewRow;
+         times[i] = source->time;
+      }, sources[i]);
+   }
+
+   // Source with the earliest next row, -1 if all are at their end
+   int earliest() const
+   {
+      int index = -1;
+      for(int i=0;i<times.size();i++)
+      {
+         if(active[i] && (index == -1 || times[i] < times[index]))
+         {
+            index = i;
+         }
+      }
+      return index;
+   }
+
+   std::vector<std::variant<std::unique_ptr<Source<RowTypes>>...>> sources;
+   std::vector<TimeBranchType> times;
+   std::vector<bool> active;
+
+   std::tuple<std::function<void(IdBranchType, TimeBranchType, const RowTypes&)>...> forEachRow;
+   std::function<void(IdBranchType, TimeBranchType, const Row&)> forEachVariant;
+   std::function<bool(IdBranchType)> idFilter;
+
+   TimeBranchType timeFrom = std::numeric_limits<TimeBranchType>::lowest();
+   TimeBranchType timeTill = std::numeric_limits<TimeBranchType>::max();
+   bool stopped = false;
+
+   long long rowsProcessed[sizeof...(RowTypes)] = {};
+   long long entriesProcessed = 0;
+};
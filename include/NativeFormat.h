@@ -0,0 +1,365 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "TTree.h"
+#include "TTreeReader.h"
+
+#include "LazyRow.h"
+#include "TimeFrameSource.h"
+#include "TimeNS.h"
+
+// Native input format: uncompressed, fixed width and time sorted, read through a memory map without decoding.
+// The file is a header followed by blocks of up to blockRows rows, the last block holds the remainder.
+// Every block stores the times, ids and rows as three columns, each padded to 64 bytes,
+// so ids and times are scanned without touching the rows they skip.
+struct NativeHeader
+{
+   static constexpr char Magic[8] = {'T', 'F', 'N', 'A', 'T', 'I', 'V', '1'};
+
+   char magic[8];
+   uint32_t idSize;
+   uint32_t timeSize;
+   uint32_t rowSize;
+   uint32_t blockRows;
+   uint64_t rows;
+   char reserved[32];
+};
+
+static_assert(sizeof(NativeHeader) == 64, "Native header needs to be 64 bytes");
+
+inline uint64_t nativeColumnBytes(uint64_t rows, uint64_t size)
+{
+   return (rows * size + 63) / 64 * 64;
+}
+
+// Rows the native format can hold: plain values that are rebuilt by copying their bytes into a default constructed row.
+// Rows with lazy columns are excluded, their bytes point into a reader.
+template<class RowType>
+inline constexpr bool IsNativeRow = std::is_trivially_copyable_v<RowType> && std::is_default_constructible_v<RowType> && !HasDetach<RowType>::value;
+
+// Writes rows in time order, the header is completed when closing
+template<class RowType, class IdBranchType = int, class TimeBranchType = TimeNS>
+class NativeWriter
+{
+public:
+   NativeWriter(std::string path, uint32_t blockRows = 65536)
+   :  path(path), blockRows(blockRows)
+   {
+      // Checked on construction, so a writer can be held for any row type
+      static_assert(IsNativeRow<RowType>, "The native format needs trivially copyable, default constructible rows without lazy columns");
+
+      file = std::fopen(path.c_str(), "wb");
+      if(file == nullptr)
+      {
+         throw std::runtime_error("Cannot create native file " + path);
+      }
+
+      std::memset(&header, 0, sizeof(header));
+      std::memcpy(header.magic, NativeHeader::Magic, sizeof(header.magic));
+      header.idSize = sizeof(IdBranchType);
+      header.timeSize = sizeof(TimeBranchType);
+      header.rowSize = sizeof(RowType);
+      header.blockRows = blockRows;
+
+      write(&header, sizeof(header));
+   }
+
+   // Closes a writer that was not closed, errors can only be reported here, call close to handle them
+   ~NativeWriter()
+   {
+      if(file != nullptr)
+      {
+         try
+         {
+            close();
+         }
+         catch(std::exception& error)
+         {
+            std::cout << "Error: " << error.what() << "\n";
+         }
+      }
+   }
+
+   NativeWriter(const NativeWriter&) = delete;
+   NativeWriter& operator=(const NativeWriter&) = delete;
+
+   void push_back(IdBranchType id, TimeBranchType time, const RowType& row)
+   {
+      if(time < lastTime)
+      {
+         throw std::runtime_error("Native file " + path + " needs rows in time order");
+      }
+      lastTime = time;
+
+      ids.push_back(id);
+      times.push_back(time);
+      rows.push_back(row);
+
+      if(times.size() == blockRows)
+      {
+         writeBlock();
+      }
+   }
+
+   void close()
+   {
+      writeBlock();
+
+      std::fseek(file, 0, SEEK_SET);
+      write(&header, sizeof(header));
+
+      bool failed = std::fclose(file) != 0;
+      file = nullptr;
+      if(failed)
+      {
+         throw std::runtime_error("Cannot write native file " + path);
+      }
+   }
+
+   uint64_t getRowsWritten() const
+   {
+      return header.rows + times.size();
+   }
+
+private:
+   void writeBlock()
+   {
+      if(times.size() == 0)
+      {
+         return;
+      }
+
+      writeColumn(times.data(), times.size(), sizeof(TimeBranchType));
+      writeColumn(ids.data(), ids.size(), sizeof(IdBranchType));
+      writeColumn(rows.data(), rows.size(), sizeof(RowType));
+
+      header.rows += times.size();
+
+      ids.clear();
+      times.clear();
+      rows.clear();
+   }
+
+   void writeColumn(const void* data, uint64_t n, uint64_t size)
+   {
+      static const char padding[64] = {};
+
+      write(data, n * size);
+      write(padding, nativeColumnBytes(n, size) - n * size);
+   }
+
+   void write(const void* data, size_t size)
+   {
+      if(size > 0 && std::fwrite(data, 1, size, file) != size)
+      {
+         throw std::runtime_error("Cannot write native file " + path);
+      }
+   }
+
+   std::string path;
+   uint32_t blockRows;
+   std::FILE* file = nullptr;
+
+   NativeHeader header;
+
+   std::vector<IdBranchType> ids;
+   std::vector<TimeBranchType> times;
+   std::vector<RowType> rows;
+   TimeBranchType lastTime = std::numeric_limits<TimeBranchType>::lowest();
+};
+
+// Reads a native file through a memory map, rows are copied straight from the mapping
+template<class RowType, class IdBranchType = int, class TimeBranchType = TimeNS>
+class NativeSource : public TimeFrameSource<RowType, IdBranchType, TimeBranchType>
+{
+public:
+   NativeSource(std::string path)
+   :  path(path)
+   {
+      static_assert(IsNativeRow<RowType>, "The native format needs trivially copyable, default constructible rows without lazy columns");
+
+      int fd = open(path.c_str(), O_RDONLY);
+      if(fd < 0)
+      {
+         throw std::runtime_error("Cannot open native file " + path);
+      }
+
+      struct stat status;
+      fstat(fd, &status);
+      size = status.st_size;
+
+      if(size < sizeof(NativeHeader))
+      {
+         ::close(fd);
+         throw std::runtime_error("Not a native file: " + path);
+      }
+
+      data = (const char*) mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+
+      if(data == MAP_FAILED)
+      {
+         throw std::runtime_error("Cannot map native file " + path);
+      }
+      madvise((void*) data, size, MADV_SEQUENTIAL);
+
+      std::memcpy(&header, data, sizeof(header));
+      if(std::memcmp(header.magic, NativeHeader::Magic, sizeof(header.magic)) != 0
+         || header.idSize != sizeof(IdBranchType) || header.timeSize != sizeof(TimeBranchType) || header.rowSize != sizeof(RowType))
+      {
+         munmap((void*) data, size);
+         throw std::runtime_error("Native file " + path + " is not in the format of this TimeFrame");
+      }
+   }
+
+   ~NativeSource()
+   {
+      munmap((void*) data, size);
+   }
+
+   NativeSource(const NativeSource&) = delete;
+   NativeSource& operator=(const NativeSource&) = delete;
+
+   void prepareNext(const std::function<bool(IdBranchType)>& idFilter, const std::function<void()>& preFilterCallback) override
+   {
+      while(true)
+      {
+         position++;
+         if(position >= blockEnd && !loadBlock())
+         {
+            this->hasNewRow = false;
+            return;
+         }
+
+         preFilterCallback();
+
+         size_t i = position - blockStart;
+         if(idFilter(ids[i]) && this->timeFrom <= times[i])
+         {
+            if(times[i] < this->lastTime)
+            {
+               this->messagesSkipped++;
+            }
+            else
+            {
+               this->id = ids[i];
+               this->time = times[i];
+               this->lastTime = times[i];
+               this->hasNewRow = true;
+               return;
+            }
+         }
+      }
+   }
+
+   RowType readRow() override
+   {
+      RowType row;
+      std::memcpy((void*) &row, rows + (position - blockStart), sizeof(RowType));
+      return row;
+   }
+
+   long getNumberEntries() override
+   {
+      return header.rows;
+   }
+
+   std::string getCacheKey() override
+   {
+      return "native:" + sourceFileKey(path);
+   }
+
+private:
+   bool loadBlock()
+   {
+      if(blockEnd >= header.rows)
+      {
+         return false;
+      }
+
+      if(blockEnd > 0)
+      {
+         offset += nativeColumnBytes(blockEnd - blockStart, sizeof(TimeBranchType))
+            + nativeColumnBytes(blockEnd - blockStart, sizeof(IdBranchType))
+            + nativeColumnBytes(blockEnd - blockStart, sizeof(RowType));
+      }
+
+      blockStart = blockEnd;
+      blockEnd = std::min<uint64_t>(blockStart + header.blockRows, header.rows);
+      uint64_t n = blockEnd - blockStart;
+
+      if(offset + nativeColumnBytes(n, sizeof(TimeBranchType)) + nativeColumnBytes(n, sizeof(IdBranchType)) + n * sizeof(RowType) > size)
+      {
+         throw std::runtime_error("Native file is truncated: " + path);
+      }
+
+      times = (const TimeBranchType*) (data + offset);
+      ids = (const IdBranchType*) (data + offset + nativeColumnBytes(n, sizeof(TimeBranchType)));
+      rows = (const RowType*) (data + offset + nativeColumnBytes(n, sizeof(TimeBranchType)) + nativeColumnBytes(n, sizeof(IdBranchType)));
+
+      return true;
+   }
+
+   std::string path;
+
+   const char* data = nullptr;
+   size_t size = 0;
+   NativeHeader header;
+
+   // Position within the file and the block it is in
+   uint64_t position = (uint64_t) -1;
+   uint64_t blockStart = 0;
+   uint64_t blockEnd = 0;
+   uint64_t offset = sizeof(NativeHeader);
+
+   const TimeBranchType* times = nullptr;
+   const IdBranchType* ids = nullptr;
+   const RowType* rows = nullptr;
+};
+
+// Converts a time ordered tree or chain into a native file, rows are read with the row reader of the TimeFrame.
+// Throws on the first row out of order rather than dropping it.
+template<class RowType, class RowReaderType, class IdBranchType = int, class TimeBranchType = TimeNS>
+uint64_t convertToNative(TTree* tree, std::string path, std::string idBranchName = "id", std::string timeBranchName = "time")
+{
+   TTreeReader reader(tree);
+   TTreeReaderValue<IdBranchType> id(reader, idBranchName.c_str());
+   TTreeReaderValue<TimeBranchType> time(reader, timeBranchName.c_str());
+   RowReaderType rowReader(reader);
+
+   NativeWriter<RowType, IdBranchType, TimeBranchType> writer(path);
+
+   TimeBranchType lastTime = std::numeric_limits<TimeBranchType>::lowest();
+   while(reader.Next())
+   {
+      // A chain of files covering the same time span is not in order, those are merged by a TimeFrame instead
+      if(*time < lastTime)
+      {
+         long long entry = reader.GetCurrentEntry();
+         writer.close();
+         std::remove(path.c_str());
+         throw std::runtime_error("Row " + std::to_string(entry) + " is out of order, " + path + " not written");
+      }
+
+      lastTime = *time;
+      writer.push_back(*id, *time, rowReader.get());
+   }
+
+   writer.close();
+
+   return writer.getRowsWritten();
+}
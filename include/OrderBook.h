@@ -0,0 +1,430 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class BookSide { Bid, Ask };
+
+template<class QuantityType>
+struct Templated_BookLevel
+{
+   QuantityType quantity = 0;
+   int orders = 0;
+};
+
+// Level of a snapshot, best first
+template<class QuantityType>
+struct Templated_BookLevelView
+{
+   double price = 0;
+   QuantityType quantity = 0;
+   int orders = 0;
+};
+
+// One side of a book in keys that grow away from the touch, the tick price for asks and the negated tick price for bids.
+// Levels within a window around the touch are kept in an array indexed by key, the rare levels further away in a map.
+// The window always holds the best level, it is moved when the touch leaves it.
+template<class QuantityType>
+class Templated_BookSide
+{
+public:
+   using Level = Templated_BookLevel<QuantityType>;
+
+   Templated_BookSide(int windowSize)
+   :  levels(windowSize)
+   {
+
+   }
+
+   void update(long long key, QuantityType quantity, int orders)
+   {
+      if(nonEmpty == 0 && outside.size() == 0)
+      {
+         moveWindow(key);
+      }
+      else if(key < base)
+      {
+         // Better than the best level
+         moveWindow(key);
+      }
+
+      Level& level = key < base + (long long) levels.size() ? levels[key - base] : outside[key];
+      bool wasEmpty = level.quantity <= 0;
+
+      level.quantity += quantity;
+      level.orders += orders;
+
+      if(key >= base + (long long) levels.size())
+      {
+         if(level.quantity <= 0)
+         {
+            outside.erase(key);
+         }
+         return;
+      }
+
+      if(wasEmpty && level.quantity <= 0)
+      {
+         level = Level();
+      }
+      else if(wasEmpty)
+      {
+         nonEmpty++;
+         if(key < best)
+         {
+            best = key;
+         }
+      }
+      else if(!wasEmpty && level.quantity <= 0)
+      {
+         level = Level();
+         nonEmpty--;
+         if(key == best)
+         {
+            findBest();
+         }
+      }
+   }
+
+   // Level of an L2 feed, replaces the quantity and the number of orders
+   void set(long long key, QuantityType quantity, int orders)
+   {
+      const Level* current = find(key);
+      update(key, quantity - (current ? current->quantity : 0), orders - (current ? current->orders : 0));
+   }
+
+   bool empty() const
+   {
+      return nonEmpty == 0;
+   }
+
+   long long bestKey() const
+   {
+      return best;
+   }
+   const Level& bestLevel() const
+   {
+      return levels[best - base];
+   }
+
+   const Level* find(long long key) const
+   {
+      if(key >= base && key < base + (long long) levels.size())
+      {
+         return levels[key - base].quantity > 0 ? &levels[key - base] : nullptr;
+      }
+      auto it = outside.find(key);
+      return it != outside.end() ? &it->second : nullptr;
+   }
+
+   // Calls func(key, level) for the n best levels, best first
+   template<class Func>
+   void top(int n, Func func) const
+   {
+      // The best key is Empty then, best - base would overflow for a negative base as on the bid side
+      if(nonEmpty == 0 && outside.empty())
+      {
+         return;
+      }
+
+      int found = 0;
+      int foundInWindow = 0;
+      for(long long i = best - base; i < (long long) levels.size() && found < n && foundInWindow < nonEmpty; i++)
+      {
+         if(levels[i].quantity > 0)
+         {
+            func(base + i, levels[i]);
+            found++;
+            foundInWindow++;
+         }
+      }
+      for(auto it = outside.begin(); it != outside.end() && found < n; it++)
+      {
+         func(it->first, it->second);
+         found++;
+      }
+   }
+
+   int numberLevels() const
+   {
+      return nonEmpty + outside.size();
+   }
+
+   void clear()
+   {
+      std::fill(levels.begin(), levels.end(), Level());
+      outside.clear();
+      nonEmpty = 0;
+      best = Empty;
+   }
+
+private:
+   static constexpr long long Empty = std::numeric_limits<long long>::max();
+
+   // The next level after the best one was removed, usually a few ticks away
+   void findBest()
+   {
+      if(nonEmpty > 0)
+      {
+         long long i = best - base;
+         while(levels[i].quantity <= 0)
+         {
+            i++;
+         }
+         best = base + i;
+      }
+      else if(outside.size() > 0)
+      {
+         moveWindow(outside.begin()->first);
+      }
+      else
+      {
+         best = Empty;
+      }
+   }
+
+   // Places the key a quarter into the window, most levels are behind the touch
+   void moveWindow(long long key)
+   {
+      for(long long i = 0; i < (long long) levels.size(); i++)
+      {
+         if(levels[i].quantity > 0)
+         {
+            outside[base + i] = levels[i];
+            levels[i] = Level();
+         }
+      }
+
+      base = key - (long long) levels.size() / 4;
+      nonEmpty = 0;
+      best = Empty;
+
+      auto it = outside.lower_bound(base);
+      while(it != outside.end() && it->first < base + (long long) levels.size())
+      {
+         levels[it->first - base] = it->second;
+         nonEmpty++;
+         best = std::min(best, it->first);
+         it = outside.erase(it);
+      }
+   }
+
+   std::vector<Level> levels;
+   long long base = 0;
+   int nonEmpty = 0;
+   long long best = Empty;
+
+   std::map<long long, Level> outside;
+};
+
+// Limit order book to be used as StateType, fed either by levels (L2) or by orders (L3).
+// Prices are kept as ticks, the best bid and ask are known at any time and the top levels are read without searching.
+//
+// For an L3 feed of rows like
+//
+// struct OrderEvent { char type; uint64_t orderId; BookSide side; double price; long long quantity; };
+//
+// timeFrame.setStateInitializer([](int id){ return OrderBook<>(0.01); });
+// timeFrame.setStateUpdater([](int id, TimeNS time, OrderBook<>& book, const OrderEvent& e)
+// {
+//    if(e.type == 'A') book.addOrder(e.orderId, e.side, e.price, e.quantity);
+//    else if(e.type == 'E') book.reduceOrder(e.orderId, e.quantity);
+//    else if(e.type == 'D') book.cancelOrder(e.orderId);
+// });
+//
+// src/Iterate.cpp feeds levels (L2) from the example messages.
+template<class QuantityType = long long>
+class OrderBook
+{
+public:
+   using Level = Templated_BookLevel<QuantityType>;
+   using LevelView = Templated_BookLevelView<QuantityType>;
+   using Side = Templated_BookSide<QuantityType>;
+
+   // The window holds the levels within windowSize ticks around the touch in arrays
+   OrderBook(double tickSize = 0.01, int windowSize = 2048)
+   :  tickSize(tickSize),
+      bids(windowSize),
+      asks(windowSize)
+   {
+      if(tickSize <= 0 || windowSize < 4)
+      {
+         throw std::runtime_error("Order book needs a positive tick size and a window of at least 4 ticks");
+      }
+   }
+
+   void setLevel(BookSide side, double price, QuantityType quantity, int orders = 0)
+   {
+      sideOf(side).set(key(side, toTicks(price)), quantity, orders);
+   }
+
+   void addOrder(uint64_t orderId, BookSide side, double price, QuantityType quantity)
+   {
+      long long k = key(side, toTicks(price));
+      if(!orders.emplace(orderId, Order{k, quantity, side}).second)
+      {
+         throw std::runtime_error("Order " + std::to_string(orderId) + " is already in the book");
+      }
+      sideOf(side).update(k, quantity, 1);
+   }
+
+   // Executed or partly cancelled, the order is removed when nothing is left
+   void reduceOrder(uint64_t orderId, QuantityType quantity)
+   {
+      auto it = orders.find(orderId);
+      if(it == orders.end())
+      {
+         unknownOrders++;
+         return;
+      }
+
+      Order& order = it->second;
+      quantity = std::min(quantity, order.quantity);
+      order.quantity -= quantity;
+      bool removed = order.quantity <= 0;
+
+      sideOf(order.side).update(order.key, -quantity, removed ? -1 : 0);
+      if(removed)
+      {
+         orders.erase(it);
+      }
+   }
+
+   void cancelOrder(uint64_t orderId)
+   {
+      auto it = orders.find(orderId);
+      if(it == orders.end())
+      {
+         unknownOrders++;
+         return;
+      }
+
+      sideOf(it->second.side).update(it->second.key, -it->second.quantity, -1);
+      orders.erase(it);
+   }
+
+   // New price or quantity, the order loses its priority
+   void replaceOrder(uint64_t orderId, uint64_t newOrderId, double price, QuantityType quantity)
+   {
+      auto it = orders.find(orderId);
+      if(it == orders.end())
+      {
+         unknownOrders++;
+         return;
+      }
+
+      BookSide side = it->second.side;
+      cancelOrder(orderId);
+      addOrder(newOrderId, side, price, quantity);
+   }
+
+   bool hasBid() const
+   {
+      return !bids.empty();
+   }
+   bool hasAsk() const
+   {
+      return !asks.empty();
+   }
+
+   double bestBid() const
+   {
+      return hasBid() ? -bids.bestKey() * tickSize : std::nan("");
+   }
+   double bestAsk() const
+   {
+      return hasAsk() ? asks.bestKey() * tickSize : std::nan("");
+   }
+   QuantityType bestBidQuantity() const
+   {
+      return hasBid() ? bids.bestLevel().quantity : 0;
+   }
+   QuantityType bestAskQuantity() const
+   {
+      return hasAsk() ? asks.bestLevel().quantity : 0;
+   }
+
+   double mid() const
+   {
+      return (bestBid() + bestAsk()) / 2;
+   }
+   double spread() const
+   {
+      return bestAsk() - bestBid();
+   }
+
+   QuantityType quantityAt(BookSide side, double price) const
+   {
+      const Level* level = (side == BookSide::Bid ? bids : asks).find(key(side, toTicks(price)));
+      return level ? level->quantity : 0;
+   }
+
+   // The n best levels of a side, best first, into a vector that is reused between snapshots
+   void top(BookSide side, int n, std::vector<LevelView>& out) const
+   {
+      out.clear();
+      (side == BookSide::Bid ? bids : asks).top(n, [&](long long k, const Level& level)
+      {
+         out.push_back(LevelView{(side == BookSide::Bid ? -k : k) * tickSize, level.quantity, level.orders});
+      });
+   }
+
+   int numberLevels(BookSide side) const
+   {
+      return (side == BookSide::Bid ? bids : asks).numberLevels();
+   }
+   size_t numberOrders() const
+   {
+      return orders.size();
+   }
+   // Reductions and cancels of orders not in the book, e.g. added before the data starts
+   long long getUnknownOrders() const
+   {
+      return unknownOrders;
+   }
+
+   void clear()
+   {
+      bids.clear();
+      asks.clear();
+      orders.clear();
+   }
+
+   long long toTicks(double price) const
+   {
+      return std::llround(price / tickSize);
+   }
+
+private:
+   struct Order
+   {
+      long long key;
+      QuantityType quantity;
+      BookSide side;
+   };
+
+   static long long key(BookSide side, long long ticks)
+   {
+      return side == BookSide::Bid ? -ticks : ticks;
+   }
+
+   Side& sideOf(BookSide side)
+   {
+      return side == BookSide::Bid ? bids : asks;
+   }
+
+   double tickSize;
+
+   Side bids;
+   Side asks;
+
+   std::unordered_map<uint64_t, Order> orders;
+   long long unknownOrders = 0;
+};
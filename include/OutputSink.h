@@ -0,0 +1,230 @@
+#pragma once
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TROOT.h"
+
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes result records into a TTree on a dedicated writer thread.
+// Handlers only append to the front buffer, full buffers are swapped with the buffer the writer thread fills from.
+//
+// RecordWriterType is the counterpart of a row reader: it is constructed with the output tree to create its branches
+// and set(record) copies a record into the branch buffers before each fill, e.g.
+//
+// struct SignalWriter
+// {
+//    SignalWriter(TTree& tree) { tree.Branch("id", &id); tree.Branch("time", &time); tree.Branch("value", &value); }
+//    void set(const Signal& s) { id = s.id; time = s.time; value = s.value; }
+//
+//    int id; TimeNS time; double value;
+// };
+template<class RecordType, class RecordWriterType>
+class OutputSink
+{
+public:
+   OutputSink(std::string fileName, std::string treeName, size_t batchSize = 65536, int compressionSettings = -1)
+   :  batchSize(batchSize)
+   {
+      ROOT::EnableThreadSafety();
+
+      front.reserve(batchSize);
+      back.reserve(batchSize);
+
+      writer = std::thread([this, fileName, treeName, compressionSettings]()
+      {
+         write(fileName, treeName, compressionSettings);
+      });
+   }
+
+   // Errors can only be reported here, call close to handle them
+   ~OutputSink()
+   {
+      try
+      {
+         close();
+      }
+      catch(std::exception& error)
+      {
+         std::cout << "Error: " << error.what() << "\n";
+      }
+   }
+
+   OutputSink(const OutputSink&) = delete;
+   OutputSink& operator=(const OutputSink&) = delete;
+
+   void push(const RecordType& record)
+   {
+      front.push_back(record);
+      if(front.size() >= batchSize)
+      {
+         flush();
+      }
+   }
+   template<class... Args>
+   void emplace(Args&&... args)
+   {
+      front.emplace_back(std::forward<Args>(args)...);
+      if(front.size() >= batchSize)
+      {
+         flush();
+      }
+   }
+
+   // Hand the buffered records to the writer thread, only blocks while the previous batch is still being written.
+   // Throws once the writer failed, the records are not written then.
+   void flush()
+   {
+      if(front.empty())
+      {
+         return;
+      }
+
+      std::unique_lock<std::mutex> lock(mutex);
+      batchWritten.wait(lock, [&](){ return !writerBusy; });
+
+      if(error.size() > 0)
+      {
+         throw std::runtime_error("Output sink: " + error);
+      }
+
+      std::swap(front, back);
+      writerBusy = true;
+
+      lock.unlock();
+      batchReady.notify_one();
+   }
+
+   // Write the remaining records and close the file, called by the destructor if not done before.
+   // Throws if the writer failed, the file is incomplete then.
+   void close()
+   {
+      if(writer.joinable())
+      {
+         try
+         {
+            flush();
+         }
+         catch(std::exception&)
+         {
+            front.clear();
+         }
+
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            closing = true;
+         }
+         batchReady.notify_one();
+
+         writer.join();
+
+         if(error.size() > 0)
+         {
+            throw std::runtime_error("Output sink: " + error);
+         }
+      }
+   }
+
+   long getRecordsWritten()
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      return recordsWritten;
+   }
+
+private:
+   void write(std::string fileName, std::string treeName, int compressionSettings)
+   {
+      TFile file(fileName.c_str(), "RECREATE", "");
+      if(file.IsZombie())
+      {
+         fail("cannot create " + fileName);
+         return;
+      }
+      if(compressionSettings >= 0)
+      {
+         file.SetCompressionSettings(compressionSettings);
+      }
+
+      // Owned by the file, deleted when it is closed
+      TTree* tree = new TTree(treeName.c_str(), "");
+      RecordWriterType recordWriter(*tree);
+
+      while(true)
+      {
+         std::unique_lock<std::mutex> lock(mutex);
+         batchReady.wait(lock, [&](){ return writerBusy || closing; });
+
+         if(!writerBusy)
+         {
+            break;
+         }
+         lock.unlock();
+
+         // The back buffer belongs to this thread until writerBusy is reset
+         long filled = 0;
+         for(const auto& record : back)
+         {
+            recordWriter.set(record);
+            if(tree->Fill() < 0)
+            {
+               break;
+            }
+            filled++;
+         }
+
+         lock.lock();
+         recordsWritten += filled;
+         bool failed = filled < (long) back.size() || file.TestBit(TFile::kWriteError);
+         back.clear();
+         writerBusy = false;
+         lock.unlock();
+
+         if(failed)
+         {
+            fail("cannot write to " + fileName);
+            return;
+         }
+
+         batchWritten.notify_one();
+      }
+
+      file.Write();
+      if(file.TestBit(TFile::kWriteError))
+      {
+         fail("cannot write " + fileName);
+      }
+      file.Close();
+   }
+
+   // Stops the writer, later batches are refused instead of being filled into a broken file
+   void fail(std::string message)
+   {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         error = message;
+         writerBusy = false;
+      }
+      batchWritten.notify_all();
+   }
+
+   size_t batchSize;
+
+   std::vector<RecordType> front;
+   std::vector<RecordType> back;
+
+   std::thread writer;
+   std::mutex mutex;
+   std::condition_variable batchReady;
+   std::condition_variable batchWritten;
+   bool writerBusy = false;
+   bool closing = false;
+
+   long recordsWritten = 0;
+   std::string error;
+};
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Slab allocator for rows: every row is constructed once in a chunk and passed around by handle.
+// Handles count the references per chunk, a chunk is reused as soon as it is full and no handle refers to it anymore.
+// Not thread safe, handles have to be copied and destroyed on the thread owning the arena.
+template<class RowType, int ChunkRows = 1024>
+class RowArena
+{
+   struct Chunk
+   {
+      RowType* at(int i)
+      {
+         return std::launder(reinterpret_cast<RowType*>(storage) + i);
+      }
+
+      alignas(RowType) unsigned char storage[ChunkRows * sizeof(RowType)];
+      int used = 0;
+      long references = 0;
+      RowArena* arena = nullptr;
+   };
+
+public:
+   class Handle
+   {
+   public:
+      Handle()
+      {
+
+      }
+      Handle(const Handle& other)
+      : chunk(other.chunk), row(other.row)
+      {
+         if(chunk)
+         {
+            chunk->references++;
+         }
+      }
+      Handle(Handle&& other) noexcept
+      : chunk(other.chunk), row(other.row)
+      {
+         other.chunk = nullptr;
+         other.row = nullptr;
+      }
+      Handle& operator=(Handle other) noexcept
+      {
+         std::swap(chunk, other.chunk);
+         std::swap(row, other.row);
+         return *this;
+      }
+      ~Handle()
+      {
+         if(chunk)
+         {
+            chunk->arena->release(chunk);
+         }
+      }
+
+      const RowType& operator*() const
+      {
+         return *row;
+      }
+      const RowType* operator->() const
+      {
+         return row;
+      }
+      explicit operator bool() const
+      {
+         return row != nullptr;
+      }
+
+   private:
+      friend class RowArena;
+
+      Handle(Chunk* c, RowType* r)
+      : chunk(c), row(r)
+      {
+         chunk->references++;
+      }
+
+      Chunk* chunk = nullptr;
+      RowType* row = nullptr;
+   };
+
+   RowArena()
+   {
+
+   }
+
+   // All handles need to be gone before the arena is destroyed
+   ~RowArena()
+   {
+      for(auto& chunk : chunks)
+      {
+         destroyRows(chunk.get());
+      }
+   }
+
+   RowArena(const RowArena&) = delete;
+   RowArena& operator=(const RowArena&) = delete;
+
+   template<class... Args>
+   Handle emplace(Args&&... args)
+   {
+      if(current == nullptr || current->used == ChunkRows)
+      {
+         Chunk* full = current;
+         current = acquireChunk();
+
+         if(full != nullptr && full->references == 0)
+         {
+            recycle(full);
+         }
+      }
+
+      RowType* row = new (current->at(current->used)) RowType(std::forward<Args>(args)...);
+      current->used++;
+
+      return Handle(current, row);
+   }
+
+   // Rows held in chunks that are still referenced, including rows of those chunks no handle refers to
+   long rowsInUse() const
+   {
+      return (long) (chunks.size() - freeChunks.size()) * ChunkRows;
+   }
+
+private:
+   void release(Chunk* chunk)
+   {
+      chunk->references--;
+      if(chunk->references == 0 && chunk != current)
+      {
+         recycle(chunk);
+      }
+   }
+
+   Chunk* acquireChunk()
+   {
+      if(freeChunks.size() > 0)
+      {
+         Chunk* chunk = freeChunks.back();
+         freeChunks.pop_back();
+         return chunk;
+      }
+
+      chunks.emplace_back(std::make_unique<Chunk>());
+      chunks.back()->arena = this;
+      return chunks.back().get();
+   }
+
+   void recycle(Chunk* chunk)
+   {
+      destroyRows(chunk);
+      freeChunks.push_back(chunk);
+   }
+
+   void destroyRows(Chunk* chunk)
+   {
+      for(int i = 0; i < chunk->used; i++)
+      {
+         chunk->at(i)->~RowType();
+      }
+      chunk->used = 0;
+   }
+
+   std::vector<std::unique_ptr<Chunk>> chunks;
+   std::vector<Chunk*> freeChunks;
+   Chunk* current = nullptr;
+};
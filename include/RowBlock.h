@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "RowArena.h"
+
+// One bit per row of a block, set by batch predicates for the rows they select
+struct SelectionMask
+{
+   void reset(size_t n)
+   {
+      words.assign((n + 63) / 64, 0);
+   }
+   void set(size_t i)
+   {
+      words[i / 64] |= 1ULL << (i % 64);
+   }
+   bool test(size_t i) const
+   {
+      return (words[i / 64] >> (i % 64)) & 1ULL;
+   }
+
+   // Word i holds rows 64 * i until 64 * i + 63, predicates evaluated with SIMD can write whole words
+   std::vector<uint64_t> words;
+};
+
+// Consecutive rows of the merged stream in columns, the input of batch predicates
+template<class IdBranchType, class TimeBranchType, class RowType>
+struct Templated_RowBlock
+{
+   using RowHandle = typename RowArena<RowType>::Handle;
+
+   size_t size() const
+   {
+      return ids.size();
+   }
+   const RowType& row(size_t i) const
+   {
+      return *rows[i];
+   }
+
+   // Gathers a field of every row into a contiguous column, the vector is reused between blocks
+   template<class T, class Extract>
+   void column(std::vector<T>& values, Extract extract) const
+   {
+      values.resize(rows.size());
+      for(size_t i = 0; i < rows.size(); i++)
+      {
+         values[i] = extract(*rows[i]);
+      }
+   }
+
+   void push_back(IdBranchType id, TimeBranchType time, const RowHandle& row)
+   {
+      ids.push_back(id);
+      times.push_back(time);
+      rows.push_back(row);
+   }
+   void clear()
+   {
+      ids.clear();
+      times.clear();
+      rows.clear();
+   }
+
+   std::vector<IdBranchType> ids;
+   std::vector<TimeBranchType> times;
+   std::vector<RowHandle> rows;
+};
@@ -0,0 +1,431 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <algorithm>
+#include <set>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Result of all workers of a scatter gather run combined
+template<class IdBranchType, class StateType, class OutputType>
+struct Templated_GatherResult
+{
+   std::map<IdBranchType, StateType> states;
+   long triggerCount = 0;
+   long long entriesProcessed = 0;    // Read by all workers, entries read by several workers are counted by each
+   long long rowsInRange = 0;         // Within the time range of the worker that owns them, counted once for a time split
+   std::vector<OutputType> outputs;    // In order of the stream time they were produced at
+   bool complete = true;               // False if a worker failed, its results are missing
+};
+
+// Outputs of a worker, stamped with the stream time they are produced at so the outputs of all workers can be stitched in time order
+template<class OutputType, class TimeBranchType>
+class Templated_OutputCollector
+{
+public:
+   void push_back(const OutputType& output)
+   {
+      outputs.push_back(output);
+      times.push_back(currentTime());
+   }
+   template<class... Args>
+   void emplace_back(Args&&... args)
+   {
+      outputs.emplace_back(std::forward<Args>(args)...);
+      times.push_back(currentTime());
+   }
+   size_t size() const
+   {
+      return outputs.size();
+   }
+
+   std::function<TimeBranchType()> currentTime;
+
+   std::vector<OutputType> outputs;
+   std::vector<TimeBranchType> times;
+};
+
+// Splits a TimeFrame job over local worker processes, each running the same configuration on a part of the ids or of the time range.
+// Workers are forked, so the configuration, handlers and everything they capture are available in every worker as they are.
+// Final states, trigger counts and outputs are sent back over pipes and gathered into one result.
+//
+// The configuration adds the chains and handlers to the TimeFrame of a worker and gets the collector its handlers push outputs to.
+// IdBranchType and OutputType need to be trivially copyable, StateType as well unless a state serializer is set.
+template<class TimeFrameType, class OutputType = char>
+class ScatterGather
+{
+public:
+   using IdBranchType = typename TimeFrameType::IdBranch;
+   using TimeBranchType = typename TimeFrameType::TimeBranch;
+   using StateType = typename TimeFrameType::State;
+   using GatherResult = Templated_GatherResult<IdBranchType, StateType, OutputType>;
+   using OutputCollector = Templated_OutputCollector<OutputType, TimeBranchType>;
+
+   ScatterGather(int workers)
+   :  workers(workers)
+   {
+      if(workers < 1)
+      {
+         throw std::runtime_error("Scatter gather needs at least one worker");
+      }
+
+      splitById();
+   }
+
+   void setConfiguration(std::function<void(TimeFrameType&, OutputCollector&)> func)
+   {
+      configuration = func;
+   }
+
+   // Ids are assigned to the workers by the shard function, by their hash if none is given
+   void splitById(std::function<int(IdBranchType)> shard = nullptr)
+   {
+      if(!shard)
+      {
+         int n = workers;
+         shard = [n](IdBranchType id){ return (int)(std::hash<IdBranchType>()(id) % n); };
+      }
+
+      splitOnTime = false;
+      splitConfiguration = [shard](TimeFrameType& timeFrame, int worker, int n)
+      {
+         auto userFilter = timeFrame.getIdFilter();
+         timeFrame.setIdFilter([=](IdBranchType id){ return shard(id) == worker && userFilter(id); });
+
+         // Workers see different ids, they must not share a cached timeline
+         timeFrame.extendTimelineCacheKey("shard " + std::to_string(worker) + " of " + std::to_string(n));
+      };
+   }
+   void splitById(std::set<IdBranchType> ids)
+   {
+      std::map<IdBranchType, int> assigned;
+      int i = 0;
+      for(const auto& id : ids)
+      {
+         assigned[id] = (i++) % workers;
+      }
+
+      splitById([assigned](IdBranchType id)
+      {
+         auto it = assigned.find(id);
+         return it != assigned.end() ? it->second : -1;
+      });
+   }
+
+   // Every worker gets an equal, consecutive part of [from, till), which also works for handlers that combine ids.
+   // A worker starts reading warm-up before its part so states have converged at its start, outputs of the warm-up are suppressed.
+   // The warm-up covers at least one snapshot window, so the snapshot at the start of a part is not lost.
+   // Outputs are in time order, the final state of an id is the one of the last worker that has seen it.
+   void splitByTime(TimeBranchType from, TimeBranchType till, TimeBranchType warmUp = 0)
+   {
+      splitOnTime = true;
+      splitConfiguration = [from, till, warmUp](TimeFrameType& timeFrame, int worker, int n)
+      {
+         TimeBranchType length = (till - from) / n;
+         TimeBranchType start = from + worker * length;
+         TimeBranchType end = worker == n - 1 ? till : start + length;
+
+         timeFrame.setTimeRange(start, end);
+         timeFrame.setWarmUp(worker == 0 ? 0 : std::max(warmUp, (TimeBranchType) timeFrame.getSnapshotWindow()));
+      };
+   }
+
+   // Combines the states of an id that is present in several workers
+   void setStateMerger(std::function<void(StateType&, const StateType&)> func)
+   {
+      stateMerger = func;
+   }
+
+   void setStateSerializer(std::function<void(const StateType&, std::string&)> serialize, std::function<StateType(const std::string&)> deserialize)
+   {
+      stateSerializer = serialize;
+      stateDeserializer = deserialize;
+   }
+
+   GatherResult run()
+   {
+      static_assert(std::is_trivially_copyable_v<IdBranchType>, "Scatter gather needs trivially copyable ids");
+      static_assert(std::is_trivially_copyable_v<OutputType>, "Scatter gather needs trivially copyable outputs");
+
+      if(!configuration)
+      {
+         throw std::runtime_error("Scatter gather has no configuration");
+      }
+      if constexpr (!std::is_trivially_copyable_v<StateType>)
+      {
+         if(!stateSerializer)
+         {
+            throw std::runtime_error("Scatter gather needs a state serializer for states that are not trivially copyable");
+         }
+      }
+
+      std::cout << std::flush;
+
+      std::vector<pid_t> pids(workers);
+      std::vector<int> pipes(workers);
+
+      for(int i = 0; i < workers; i++)
+      {
+         int fds[2];
+         if(pipe(fds) != 0)
+         {
+            throw std::runtime_error("Scatter gather cannot create pipe");
+         }
+
+         pid_t pid = fork();
+         if(pid < 0)
+         {
+            throw std::runtime_error("Scatter gather cannot fork worker");
+         }
+
+         if(pid == 0)
+         {
+            close(fds[0]);
+            for(int j = 0; j < i; j++)
+            {
+               close(pipes[j]);
+            }
+            _exit(runWorker(i, fds[1]));
+         }
+
+         close(fds[1]);
+         pids[i] = pid;
+         pipes[i] = fds[0];
+      }
+
+      // Pipes are drained concurrently, a worker blocks as soon as its pipe buffer is full
+      std::vector<std::string> messages(workers);
+      std::vector<std::thread> readers;
+      for(int i = 0; i < workers; i++)
+      {
+         readers.emplace_back([&, i]()
+         {
+            char buffer[65536];
+            ssize_t n;
+            while((n = read(pipes[i], buffer, sizeof(buffer))) > 0)
+            {
+               messages[i].append(buffer, n);
+            }
+            close(pipes[i]);
+         });
+      }
+      for(auto& reader : readers)
+      {
+         reader.join();
+      }
+
+      GatherResult result;
+      std::vector<TimeBranchType> outputTimes;
+      for(int i = 0; i < workers; i++)
+      {
+         int status = 0;
+         waitpid(pids[i], &status, 0);
+
+         if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+         {
+            std::cout << "Worker " << i << " failed, its results are missing\n";
+            result.complete = false;
+            continue;
+         }
+
+         gather(i, messages[i], result, outputTimes);
+      }
+
+      // Stable, so outputs at the same time stay in order of the workers
+      std::vector<size_t> order(result.outputs.size());
+      std::iota(order.begin(), order.end(), 0);
+      std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b){ return outputTimes[a] < outputTimes[b]; });
+
+      std::vector<OutputType> sorted;
+      sorted.reserve(order.size());
+      for(size_t i : order)
+      {
+         sorted.push_back(result.outputs[i]);
+      }
+      result.outputs.swap(sorted);
+
+      return result;
+   }
+
+private:
+   int runWorker(int worker, int fd)
+   {
+      try
+      {
+         TimeFrameType timeFrame;
+         OutputCollector outputs;
+         outputs.currentTime = [&](){ return timeFrame.getCurrentTime(); };
+
+         configuration(timeFrame, outputs);
+         splitConfiguration(timeFrame, worker, workers);
+         timeFrame.setProgressBar(false);
+
+         // A failed worker exits with an error, so the gathered result is marked incomplete
+         if(!timeFrame.run())
+         {
+            std::cout << "Worker " << worker << " failed: looping was aborted\n" << std::flush;
+            return 1;
+         }
+
+         std::string message;
+         append(message, (int64_t) timeFrame.getTriggerCount());
+         append(message, (int64_t) timeFrame.getEntriesProcessed());
+         append(message, (int64_t) timeFrame.getRowsInRange());
+
+         auto states = timeFrame.getFinalStates();
+         append(message, (uint64_t) states.size());
+         for(const auto& [id, state] : states)
+         {
+            append(message, id);
+
+            std::string bytes;
+            serializeState(state, bytes);
+            append(message, (uint64_t) bytes.size());
+            message += bytes;
+         }
+
+         append(message, (uint64_t) outputs.size());
+         message.append((const char*) outputs.outputs.data(), outputs.size() * sizeof(OutputType));
+         message.append((const char*) outputs.times.data(), outputs.size() * sizeof(TimeBranchType));
+
+         size_t written = 0;
+         while(written < message.size())
+         {
+            ssize_t n = write(fd, message.data() + written, message.size() - written);
+            if(n <= 0)
+            {
+               return 1;
+            }
+            written += n;
+         }
+         close(fd);
+
+         std::cout << "Worker " << worker << " done: " << timeFrame.getEntriesProcessed() << " rows, " << timeFrame.getTriggerCount() << " triggers\n" << std::flush;
+         return 0;
+      }
+      catch(std::exception& error)
+      {
+         std::cout << "Worker " << worker << " failed: " << error.what() << "\n" << std::flush;
+         return 1;
+      }
+   }
+
+   void gather(int worker, const std::string& message, GatherResult& result, std::vector<TimeBranchType>& outputTimes)
+   {
+      size_t offset = 0;
+
+      result.triggerCount += extract<int64_t>(message, offset);
+      result.entriesProcessed += extract<int64_t>(message, offset);
+      result.rowsInRange += extract<int64_t>(message, offset);
+
+      uint64_t numberStates = extract<uint64_t>(message, offset);
+      for(uint64_t i = 0; i < numberStates; i++)
+      {
+         IdBranchType id = extract<IdBranchType>(message, offset);
+         uint64_t size = extract<uint64_t>(message, offset);
+         StateType state = deserializeState(message.substr(offset, size));
+         offset += size;
+
+         if(splitOnTime)
+         {
+            result.states.insert_or_assign(id, state);
+         }
+         else
+         {
+            mergeState(result.states, id, state);
+         }
+      }
+
+      uint64_t numberOutputs = extract<uint64_t>(message, offset);
+      size_t first = result.outputs.size();
+      result.outputs.resize(first + numberOutputs);
+      std::memcpy((void*) (result.outputs.data() + first), message.data() + offset, numberOutputs * sizeof(OutputType));
+      offset += numberOutputs * sizeof(OutputType);
+
+      outputTimes.resize(first + numberOutputs);
+      std::memcpy((void*) (outputTimes.data() + first), message.data() + offset, numberOutputs * sizeof(TimeBranchType));
+   }
+
+   void mergeState(std::map<IdBranchType, StateType>& states, const IdBranchType& id, const StateType& state)
+   {
+      auto it = states.find(id);
+      if(it == states.end())
+      {
+         states.emplace(id, state);
+      }
+      else if(stateMerger)
+      {
+         stateMerger(it->second, state);
+      }
+      else
+      {
+         throw std::runtime_error("Scatter gather: id present in several workers, but no state merger set");
+      }
+   }
+
+   void serializeState(const StateType& state, std::string& bytes)
+   {
+      if(stateSerializer)
+      {
+         stateSerializer(state, bytes);
+      }
+      else if constexpr (std::is_trivially_copyable_v<StateType>)
+      {
+         bytes.assign((const char*) &state, sizeof(StateType));
+      }
+   }
+
+   StateType deserializeState(const std::string& bytes)
+   {
+      if constexpr (std::is_trivially_copyable_v<StateType>)
+      {
+         if(!stateDeserializer)
+         {
+            StateType state;
+            std::memcpy((void*) &state, bytes.data(), sizeof(StateType));
+            return state;
+         }
+      }
+      return stateDeserializer(bytes);
+   }
+
+   template<class T>
+   static void append(std::string& message, const T& value)
+   {
+      message.append((const char*) &value, sizeof(T));
+   }
+
+   template<class T>
+   static T extract(const std::string& message, size_t& offset)
+   {
+      if(offset + sizeof(T) > message.size())
+      {
+         throw std::runtime_error("Scatter gather: truncated worker result");
+      }
+
+      T value;
+      std::memcpy((void*) &value, message.data() + offset, sizeof(T));
+      offset += sizeof(T);
+      return value;
+   }
+
+   int workers;
+
+   std::function<void(TimeFrameType&, OutputCollector&)> configuration;
+   std::function<void(TimeFrameType&, int, int)> splitConfiguration;
+   bool splitOnTime = false;
+
+   std::function<void(StateType&, const StateType&)> stateMerger;
+   std::function<void(const StateType&, std::string&)> stateSerializer;
+   std::function<StateType(const std::string&)> stateDeserializer;
+};
@@ -0,0 +1,526 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Bounded memory summaries of distributions to be kept in states: updated in the state updater, read in snapshots.
+// Every sketch can merge another one of the same parameters, e.g. the sketches of several ids or of several workers.
+
+// Quantiles of a distribution as a merging t-digest: values are buffered and merged into at most about compression centroids,
+// which are small at the tails and large around the median, so extreme quantiles stay accurate.
+class TDigest
+{
+public:
+   TDigest(double compression = 100)
+   :  compression(compression)
+   {
+      if(compression < 10)
+      {
+         throw std::runtime_error("t-digest needs a compression of at least 10");
+      }
+
+      bufferSize = (size_t) (5 * compression);
+      centroids.reserve((size_t) (2 * compression) + 1);
+      buffer.reserve(bufferSize);
+   }
+
+   void add(double value, double weight = 1)
+   {
+      if(std::isnan(value))
+      {
+         return;
+      }
+
+      buffer.push_back({value, weight});
+      total += weight;
+      minValue = std::min(minValue, value);
+      maxValue = std::max(maxValue, value);
+
+      if(buffer.size() >= bufferSize)
+      {
+         compress();
+      }
+   }
+
+   void merge(const TDigest& other)
+   {
+      for(const auto& centroid : other.centroids)
+      {
+         buffer.push_back(centroid);
+      }
+      for(const auto& centroid : other.buffer)
+      {
+         buffer.push_back(centroid);
+      }
+
+      total += other.total;
+      minValue = std::min(minValue, other.minValue);
+      maxValue = std::max(maxValue, other.maxValue);
+
+      compress();
+   }
+
+   // Value below which a fraction q of the weight lies, NaN if empty
+   double quantile(double q) const
+   {
+      compress();
+
+      if(centroids.size() == 0)
+      {
+         return std::nan("");
+      }
+      if(q <= 0)
+      {
+         return minValue;
+      }
+      if(q >= 1)
+      {
+         return maxValue;
+      }
+
+      // Centroids are placed at the middle of their weight, the values between them are interpolated,
+      // below the first and above the last towards the minimum and the maximum
+      double index = q * total;
+      if(index < centroids[0].weight / 2)
+      {
+         return minValue + (centroids[0].mean - minValue) * index / (centroids[0].weight / 2);
+      }
+
+      double weightSoFar = centroids[0].weight / 2;
+      for(size_t i = 0; i + 1 < centroids.size(); i++)
+      {
+         double dw = (centroids[i].weight + centroids[i + 1].weight) / 2;
+         if(weightSoFar + dw > index)
+         {
+            double left = index - weightSoFar;
+            double right = weightSoFar + dw - index;
+            return (centroids[i].mean * right + centroids[i + 1].mean * left) / dw;
+         }
+         weightSoFar += dw;
+      }
+
+      const Centroid& last = centroids.back();
+      double left = index - weightSoFar;
+      return last.mean + (maxValue - last.mean) * std::min(1.0, left / (last.weight / 2));
+   }
+
+   double count() const
+   {
+      return total;
+   }
+   double min() const
+   {
+      return minValue;
+   }
+   double max() const
+   {
+      return maxValue;
+   }
+
+private:
+   struct Centroid
+   {
+      double mean;
+      double weight;
+   };
+
+   // Scale function k1: centroids may span one unit of k, which is fine grained near q = 0 and q = 1
+   double k(double q) const
+   {
+      return compression / (2 * Pi) * std::asin(2 * q - 1);
+   }
+   double q(double k) const
+   {
+      return (std::sin(k * 2 * Pi / compression) + 1) / 2;
+   }
+
+   // Also when reading, the buffered values are merged once
+   void compress() const
+   {
+      if(buffer.size() == 0)
+      {
+         return;
+      }
+
+      for(const auto& centroid : centroids)
+      {
+         buffer.push_back(centroid);
+      }
+      centroids.clear();
+
+      std::sort(buffer.begin(), buffer.end(), [](const Centroid& a, const Centroid& b){ return a.mean < b.mean; });
+
+      double weightSoFar = 0;
+      double limit = total * q(k(0) + 1);
+      Centroid current = buffer[0];
+
+      for(size_t i = 1; i < buffer.size(); i++)
+      {
+         const Centroid& next = buffer[i];
+         if(weightSoFar + current.weight + next.weight <= limit)
+         {
+            current.mean += (next.mean - current.mean) * next.weight / (current.weight + next.weight);
+            current.weight += next.weight;
+         }
+         else
+         {
+            weightSoFar += current.weight;
+            limit = total * q(k(weightSoFar / total) + 1);
+            centroids.push_back(current);
+            current = next;
+         }
+      }
+      centroids.push_back(current);
+
+      buffer.clear();
+   }
+
+   static constexpr double Pi = 3.14159265358979323846;
+
+   double compression;
+   size_t bufferSize;
+
+   mutable std::vector<Centroid> centroids;
+   mutable std::vector<Centroid> buffer;
+
+   double total = 0;
+   double minValue = std::numeric_limits<double>::infinity();
+   double maxValue = -std::numeric_limits<double>::infinity();
+};
+
+// Histogram of non negative values with a relative error of 2^-precisionBits: values below 2^precisionBits in units have a bucket each,
+// above every power of two is split into 2^precisionBits buckets. The counts are a fixed array, recording is a few instructions.
+class LogLinearHistogram
+{
+public:
+   // Values are counted in multiples of unit, those above highestValue in units in the last bucket
+   LogLinearHistogram(int precisionBits = 5, uint64_t highestValue = 1ULL << 40, double unit = 1)
+   :  precisionBits(precisionBits), unit(unit)
+   {
+      if(precisionBits < 1 || precisionBits > 16 || unit <= 0)
+      {
+         throw std::runtime_error("Histogram needs 1 to 16 precision bits and a positive unit");
+      }
+
+      highestIndex = index(highestValue);
+      counts.assign(highestIndex + 1, 0);
+   }
+
+   void add(double value, uint64_t count = 1)
+   {
+      record(toUnits(value, true), count);
+   }
+
+   void record(uint64_t units, uint64_t count = 1)
+   {
+      size_t i = index(units);
+      if(i > highestIndex)
+      {
+         i = highestIndex;
+         overflows += count;
+      }
+
+      counts[i] += count;
+      total += count;
+   }
+
+   void merge(const LogLinearHistogram& other)
+   {
+      if(other.precisionBits != precisionBits || other.unit != unit || other.counts.size() != counts.size())
+      {
+         throw std::runtime_error("Only histograms of the same precision, range and unit can be merged");
+      }
+
+      for(size_t i = 0; i < counts.size(); i++)
+      {
+         counts[i] += other.counts[i];
+      }
+      total += other.total;
+      overflows += other.overflows;
+   }
+
+   // Middle of the bucket holding the quantile, NaN if empty
+   double quantile(double q) const
+   {
+      if(total == 0)
+      {
+         return std::nan("");
+      }
+
+      uint64_t rank = (uint64_t) std::ceil(std::clamp(q, 0.0, 1.0) * total);
+      rank = std::max<uint64_t>(rank, 1);
+
+      uint64_t seen = 0;
+      for(size_t i = 0; i < counts.size(); i++)
+      {
+         seen += counts[i];
+         if(seen >= rank)
+         {
+            return (lowest(i) + highest(i)) / 2.0 * unit;
+         }
+      }
+      return highest(counts.size() - 1) * unit;
+   }
+
+   // Number of values below the value
+   uint64_t rank(double value) const
+   {
+      size_t end = std::min(index(toUnits(value, false)), highestIndex + 1);
+
+      uint64_t below = 0;
+      for(size_t i = 0; i < end; i++)
+      {
+         below += counts[i];
+      }
+      return below;
+   }
+
+   uint64_t count() const
+   {
+      return total;
+   }
+   uint64_t getOverflows() const
+   {
+      return overflows;
+   }
+
+   // Buckets with values, lowest and highest value in units of each
+   template<class Func>
+   void forEachBucket(Func func) const
+   {
+      for(size_t i = 0; i < counts.size(); i++)
+      {
+         if(counts[i] > 0)
+         {
+            func(lowest(i) * unit, highest(i) * unit, counts[i]);
+         }
+      }
+   }
+
+private:
+   // Clamped to the range of uint64_t before the conversion, which is undefined for values out of it
+   uint64_t toUnits(double value, bool round) const
+   {
+      double units = round ? std::round(value / unit) : std::floor(value / unit);
+      if(!(units > 0))
+      {
+         return 0;
+      }
+      return units >= 0x1p64 ? std::numeric_limits<uint64_t>::max() : (uint64_t) units;
+   }
+
+   size_t index(uint64_t units) const
+   {
+      uint64_t linear = 1ULL << precisionBits;
+      if(units < linear)
+      {
+         return units;
+      }
+
+      int exponent = 63 - __builtin_clzll(units);
+      int shift = exponent - precisionBits;
+      return linear + (size_t) shift * linear + ((units >> shift) - linear);
+   }
+
+   double lowest(size_t i) const
+   {
+      uint64_t linear = 1ULL << precisionBits;
+      if(i < linear)
+      {
+         return i;
+      }
+
+      size_t shift = (i - linear) / linear;
+      return std::ldexp((double) (linear + (i - linear) % linear), shift);
+   }
+   double highest(size_t i) const
+   {
+      uint64_t linear = 1ULL << precisionBits;
+      if(i < linear)
+      {
+         return i;
+      }
+
+      size_t shift = (i - linear) / linear;
+      return lowest(i) + std::ldexp(1.0, shift) - 1;
+   }
+
+   int precisionBits;
+   double unit;
+   size_t highestIndex;
+
+   std::vector<uint64_t> counts;
+   uint64_t total = 0;
+   uint64_t overflows = 0;
+};
+
+// Most frequent keys of a stream with the Space-Saving algorithm: capacity counters, a new key takes over the smallest one.
+// A count overestimates the true count by at most its error, every key more frequent than count / capacity is kept.
+template<class KeyType>
+class SpaceSaving
+{
+public:
+   struct Counter
+   {
+      KeyType key;
+      uint64_t count;
+      uint64_t error;
+   };
+
+   SpaceSaving(size_t capacity = 100)
+   :  capacity(capacity)
+   {
+      if(capacity < 1)
+      {
+         throw std::runtime_error("Space-Saving needs at least one counter");
+      }
+
+      heap.reserve(capacity);
+      positions.reserve(capacity);
+   }
+
+   void add(const KeyType& key, uint64_t count = 1)
+   {
+      total += count;
+
+      auto it = positions.find(key);
+      if(it != positions.end())
+      {
+         heap[it->second].count += count;
+         siftDown(it->second);
+      }
+      else if(heap.size() < capacity)
+      {
+         heap.push_back(Counter{key, count, 0});
+         positions[key] = heap.size() - 1;
+         siftUp(heap.size() - 1);
+      }
+      else
+      {
+         // The smallest counter is the root, its count is the error of the new key
+         positions.erase(heap[0].key);
+         heap[0] = Counter{key, heap[0].count + count, heap[0].count};
+         positions[key] = 0;
+         siftDown(0);
+      }
+   }
+
+   // Keys missing in one summary count with its smallest count, then the largest counters are kept
+   void merge(const SpaceSaving& other)
+   {
+      uint64_t missingHere = heap.size() < capacity ? 0 : heap[0].count;
+      uint64_t missingThere = other.heap.size() < other.capacity ? 0 : other.heap[0].count;
+
+      std::unordered_map<KeyType, Counter> merged;
+      for(const auto& counter : heap)
+      {
+         merged[counter.key] = Counter{counter.key, counter.count + missingThere, counter.error + missingThere};
+      }
+      for(const auto& counter : other.heap)
+      {
+         auto it = merged.find(counter.key);
+         if(it != merged.end())
+         {
+            it->second.count += counter.count - missingThere;
+            it->second.error += counter.error - missingThere;
+         }
+         else
+         {
+            merged[counter.key] = Counter{counter.key, counter.count + missingHere, counter.error + missingHere};
+         }
+      }
+
+      std::vector<Counter> counters;
+      counters.reserve(merged.size());
+      for(auto& entry : merged)
+      {
+         counters.push_back(entry.second);
+      }
+      size_t keep = std::min(capacity, counters.size());
+      std::partial_sort(counters.begin(), counters.begin() + keep, counters.end(), [](const Counter& a, const Counter& b){ return a.count > b.count; });
+      counters.resize(keep);
+
+      heap.clear();
+      positions.clear();
+      for(auto& counter : counters)
+      {
+         heap.push_back(counter);
+         positions[counter.key] = heap.size() - 1;
+         siftUp(heap.size() - 1);
+      }
+      total += other.total;
+   }
+
+   // The n most frequent keys, most frequent first
+   std::vector<Counter> top(size_t n) const
+   {
+      std::vector<Counter> counters = heap;
+      size_t keep = std::min(n, counters.size());
+      std::partial_sort(counters.begin(), counters.begin() + keep, counters.end(), [](const Counter& a, const Counter& b){ return a.count > b.count; });
+      counters.resize(keep);
+      return counters;
+   }
+
+   // Estimated count, 0 for keys not kept
+   uint64_t estimate(const KeyType& key) const
+   {
+      auto it = positions.find(key);
+      return it != positions.end() ? heap[it->second].count : 0;
+   }
+
+   uint64_t count() const
+   {
+      return total;
+   }
+
+private:
+   // Min-heap on the counts, positions follow the counters
+   void siftUp(size_t i)
+   {
+      while(i > 0 && heap[i].count < heap[(i - 1) / 2].count)
+      {
+         swap(i, (i - 1) / 2);
+         i = (i - 1) / 2;
+      }
+   }
+   void siftDown(size_t i)
+   {
+      while(true)
+      {
+         size_t smallest = i;
+         size_t left = 2 * i + 1;
+         size_t right = 2 * i + 2;
+         if(left < heap.size() && heap[left].count < heap[smallest].count)
+         {
+            smallest = left;
+         }
+         if(right < heap.size() && heap[right].count < heap[smallest].count)
+         {
+            smallest = right;
+         }
+         if(smallest == i)
+         {
+            return;
+         }
+         swap(i, smallest);
+         i = smallest;
+      }
+   }
+   void swap(size_t a, size_t b)
+   {
+      std::swap(heap[a], heap[b]);
+      positions[heap[a].key] = a;
+      positions[heap[b].key] = b;
+   }
+
+   size_t capacity;
+   std::vector<Counter> heap;
+   std::unordered_map<KeyType, size_t> positions;
+   uint64_t total = 0;
+};
@@ -0,0 +1,313 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Numbers the segment files of all windows of the process, also of windows of different types spilling on different threads
+inline long nextSpillSegmentNumber()
+{
+   static std::atomic<long> counter(0);
+   return counter++;
+}
+
+// Read only memory mapping of a spilled segment, unmapped when the last iterator using it is gone
+template<class T>
+struct SpillSegmentMapping
+{
+   SpillSegmentMapping(const std::string& path, size_t count)
+   {
+      size = count * sizeof(T);
+
+      int fd = open(path.c_str(), O_RDONLY);
+      if(fd < 0)
+      {
+         throw std::runtime_error("Spill window: cannot open segment " + path);
+      }
+
+      void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      close(fd);
+
+      if(p == MAP_FAILED)
+      {
+         throw std::runtime_error("Spill window: cannot map segment " + path);
+      }
+
+      madvise(p, size, MADV_SEQUENTIAL);
+      madvise(p, size, MADV_WILLNEED);
+
+      data = (const T*) p;
+   }
+
+   ~SpillSegmentMapping()
+   {
+      munmap((void*) data, size);
+   }
+
+   SpillSegmentMapping(const SpillSegmentMapping&) = delete;
+   SpillSegmentMapping& operator=(const SpillSegmentMapping&) = delete;
+
+   const T* data;
+   size_t size;
+};
+
+template<class T>
+struct SpillSegment
+{
+   std::shared_ptr<SpillSegmentMapping<T>> map() const
+   {
+      auto m = mapping.lock();
+      if(!m)
+      {
+         m = std::make_shared<SpillSegmentMapping<T>>(path, count);
+         mapping = m;
+      }
+      return m;
+   }
+
+   std::string path;
+   size_t count;
+
+   mutable std::weak_ptr<SpillSegmentMapping<T>> mapping;
+};
+
+// Window storage that keeps the newest entries in memory and spills older segments to local files.
+// Entries are stored as raw records, hence T has to be trivially copyable.
+// Only push_back at the end and pop_front at the start are supported, which is all an action window needs.
+template<class T>
+class SpillWindow
+{
+public:
+   class const_iterator
+   {
+   public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = T;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const T*;
+      using reference = const T&;
+
+      const_iterator(const SpillWindow* w, size_t s, size_t o)
+      : window(w), segment(s), offset(o)
+      {
+
+      }
+
+      // References into a spilled segment stay valid as long as this iterator points into the same segment
+      reference operator*() const
+      {
+         if(segment < window->cold.size())
+         {
+            if(!mapping)
+            {
+               mapping = window->cold[segment].map();
+            }
+            return mapping->data[offset];
+         }
+         return window->hot[offset];
+      }
+      pointer operator->() const
+      {
+         return &**this;
+      }
+
+      const_iterator& operator++()
+      {
+         offset++;
+         if(segment < window->cold.size() && offset == window->cold[segment].count)
+         {
+            segment++;
+            offset = 0;
+            mapping.reset();
+         }
+         return *this;
+      }
+      const_iterator operator++(int)
+      {
+         const_iterator it = *this;
+         ++(*this);
+         return it;
+      }
+
+      bool operator==(const const_iterator& other) const
+      {
+         return segment == other.segment && offset == other.offset;
+      }
+      bool operator!=(const const_iterator& other) const
+      {
+         return !(*this == other);
+      }
+
+   private:
+      const SpillWindow* window;
+      size_t segment;
+      size_t offset;
+      mutable std::shared_ptr<SpillSegmentMapping<T>> mapping;
+   };
+
+   SpillWindow(std::string directory, size_t hotEntries, size_t segmentEntries)
+   : directory(directory), hotEntries(hotEntries), segmentEntries(std::max<size_t>(segmentEntries, 1))
+   {
+
+   }
+
+   ~SpillWindow()
+   {
+      clear();
+   }
+
+   SpillWindow(const SpillWindow&) = delete;
+   SpillWindow& operator=(const SpillWindow&) = delete;
+
+   template<class... Args>
+   void emplace_back(Args&&... args)
+   {
+      hot.emplace_back(std::forward<Args>(args)...);
+      if(hot.size() >= hotEntries + segmentEntries)
+      {
+         spill();
+      }
+   }
+   void push_back(const T& t)
+   {
+      emplace_back(t);
+   }
+
+   void pop_front()
+   {
+      if(cold.size() > 0)
+      {
+         coldOffset++;
+         coldSize--;
+         if(coldOffset == cold.front().count)
+         {
+            frontMapping.reset();
+            unlink(cold.front().path.c_str());
+            cold.pop_front();
+            coldOffset = 0;
+         }
+      }
+      else
+      {
+         hot.pop_front();
+      }
+   }
+
+   const T& front() const
+   {
+      if(cold.size() > 0)
+      {
+         if(!frontMapping)
+         {
+            frontMapping = cold.front().map();
+         }
+         return frontMapping->data[coldOffset];
+      }
+      return hot.front();
+   }
+
+   const_iterator begin() const
+   {
+      return cold.size() > 0 ? const_iterator(this, 0, coldOffset) : const_iterator(this, 0, 0);
+   }
+   const_iterator end() const
+   {
+      return const_iterator(this, cold.size(), hot.size());
+   }
+   const_iterator cbegin() const
+   {
+      return begin();
+   }
+   const_iterator cend() const
+   {
+      return end();
+   }
+
+   size_t size() const
+   {
+      return coldSize + hot.size();
+   }
+   size_t spilled() const
+   {
+      return coldSize;
+   }
+
+   void clear()
+   {
+      frontMapping.reset();
+      for(auto& segment : cold)
+      {
+         unlink(segment.path.c_str());
+      }
+      cold.clear();
+      hot.clear();
+      coldOffset = 0;
+      coldSize = 0;
+   }
+
+private:
+   // Write the oldest in memory entries sequentially as one segment
+   void spill()
+   {
+      if constexpr (std::is_trivially_copyable_v<T>)
+      {
+         SpillSegment<T> segment;
+         segment.path = directory + "/timeframe_spill_" + std::to_string(getpid()) + "_" + std::to_string(nextSpillSegmentNumber()) + ".bin";
+         segment.count = segmentEntries;
+
+         buffer.resize(segmentEntries * sizeof(T));
+         for(size_t i=0;i<segmentEntries;i++)
+         {
+            std::memcpy(buffer.data() + i * sizeof(T), &hot[i], sizeof(T));
+         }
+
+         // Exclusive, a left over file of an earlier process with the same pid is not overwritten while in use
+         FILE* file = std::fopen(segment.path.c_str(), "wbx");
+         if(file == nullptr)
+         {
+            throw std::runtime_error("Spill window: cannot create segment " + segment.path);
+         }
+         size_t written = std::fwrite(buffer.data(), 1, buffer.size(), file);
+         std::fclose(file);
+
+         if(written != buffer.size())
+         {
+            unlink(segment.path.c_str());
+            throw std::runtime_error("Spill window: cannot write segment " + segment.path);
+         }
+
+         hot.erase(hot.begin(), hot.begin() + segmentEntries);
+         cold.push_back(segment);
+         coldSize += segmentEntries;
+      }
+      else
+      {
+         throw std::runtime_error("Spill window: entries need to be trivially copyable to be spilled");
+      }
+   }
+
+   std::string directory;
+   size_t hotEntries;
+   size_t segmentEntries;
+
+   std::deque<SpillSegment<T>> cold;
+   size_t coldOffset = 0;
+   size_t coldSize = 0;
+   mutable std::shared_ptr<SpillSegmentMapping<T>> frontMapping;
+
+   std::deque<T> hot;
+
+   std::vector<char> buffer;
+};
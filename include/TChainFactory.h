@@ -1,7 +1,23 @@
+#pragma once
+
 #include <string>
 #include <regex>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <condition_variable>
 
 #include "TSystem.h"
+#include "TChain.h"
+#include "TFile.h"
+#include "TROOT.h"
+
+#include "TimeNS.h"
 
 void loopDirectory(std::string path, std::function<void(std::string)> callback, std::string ext = ".root")
 {
@@ -10,7 +26,7 @@ void loopDirectory(std::string path, std::function<void(std::string)> callback,
    const char* entry;
    TString str;
 
-   while((entry = (char*)gSystem->GetDirEntry(dirp))) 
+   while((entry = (char*)gSystem->GetDirEntry(dirp)))
    {
       char* file = gSystem->ConcatFileName(path.c_str(), entry);
 
@@ -30,9 +46,10 @@ TChain* makeChain(std::string treeName, std::string path, std::string regexStr =
 {
    TChain* chain = new TChain(treeName.c_str());
 
+   const std::regex regex(regexStr);
+
    loopDirectory(path, [&](std::string file)
    {
-      const std::regex regex(regexStr);
       if(std::regex_match(file, regex))
       {
          std::cout << "Add file to chain: " << file << "\n";
@@ -41,4 +58,261 @@ TChain* makeChain(std::string treeName, std::string path, std::string regexStr =
    });
 
    return chain;
-}
\ No newline at end of file
+}
+
+// Summary of a file in a chain, read once before running
+template<class TimeBranchType = TimeNS>
+struct Templated_ChainFile
+{
+   std::string path;
+   long entries = 0;
+   TimeBranchType firstTime = TimeBranchType();   // Earliest time in the file
+   TimeBranchType lastTime = TimeBranchType();    // Latest time in the file
+   bool sorted = true;                            // Entries in time order
+};
+
+using ChainFile = Templated_ChainFile<TimeNS>;
+
+int defaultNumberThreads(int threads)
+{
+   return threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Scans directories for files matching the regex on their full path, subdirectories are scanned concurrently
+std::vector<std::string> findFiles(std::string path, std::string regexStr = ".*", bool recursive = true, int threads = 0, std::string ext = ".root")
+{
+   namespace fs = std::filesystem;
+
+   const std::regex regex(regexStr);
+
+   std::mutex mutex;
+   std::condition_variable directoryAdded;
+   std::deque<fs::path> directories = {fs::path(path)};
+   int busy = 0;
+
+   std::vector<std::string> files;
+
+   auto scan = [&]()
+   {
+      while(true)
+      {
+         std::unique_lock<std::mutex> lock(mutex);
+         directoryAdded.wait(lock, [&](){ return directories.size() > 0 || busy == 0; });
+
+         if(directories.size() == 0)
+         {
+            directoryAdded.notify_all();
+            return;
+         }
+
+         fs::path directory = directories.front();
+         directories.pop_front();
+         busy++;
+         lock.unlock();
+
+         std::vector<fs::path> foundDirectories;
+         std::vector<std::string> foundFiles;
+
+         std::error_code error;
+         for(const auto& entry : fs::directory_iterator(directory, error))
+         {
+            if(entry.is_directory(error))
+            {
+               if(recursive)
+               {
+                  foundDirectories.push_back(entry.path());
+               }
+            }
+            else
+            {
+               std::string file = entry.path().string();
+               if(entry.path().extension() == ext && std::regex_match(file, regex))
+               {
+                  foundFiles.push_back(file);
+               }
+            }
+         }
+         if(error)
+         {
+            std::cout << "Cannot scan directory " << directory << ": " << error.message() << "\n";
+         }
+
+         lock.lock();
+         directories.insert(directories.end(), foundDirectories.begin(), foundDirectories.end());
+         files.insert(files.end(), foundFiles.begin(), foundFiles.end());
+         busy--;
+         lock.unlock();
+
+         directoryAdded.notify_all();
+      }
+   };
+
+   std::vector<std::thread> workers;
+   for(int i = 0; i < defaultNumberThreads(threads); i++)
+   {
+      workers.emplace_back(scan);
+   }
+   for(auto& worker : workers)
+   {
+      worker.join();
+   }
+
+   std::sort(files.begin(), files.end());
+
+   return files;
+}
+
+// Reads entry count and earliest and latest timestamp of every file concurrently, files without the tree are left out.
+// Only the first and last entry are read, as the merge requires every file in time order anyway.
+// With scanAll every time is read, which recognizes files that are not in time order at the cost of reading all time baskets.
+template<class TimeBranchType = TimeNS>
+std::vector<Templated_ChainFile<TimeBranchType>> readChainFiles(const std::vector<std::string>& files, std::string treeName,
+   std::string timeBranchName = "time", int threads = 0, bool scanAll = false)
+{
+   ROOT::EnableThreadSafety();
+
+   std::vector<Templated_ChainFile<TimeBranchType>> chainFiles(files.size());
+   std::vector<char> valid(files.size(), false);
+   std::atomic<size_t> next(0);
+
+   auto read = [&]()
+   {
+      size_t i;
+      while((i = next++) < files.size())
+      {
+         std::unique_ptr<TFile> file(TFile::Open(files[i].c_str(), "READ"));
+         if(!file || file->IsZombie())
+         {
+            continue;
+         }
+
+         TTree* tree = file->Get<TTree>(treeName.c_str());
+         if(tree == nullptr)
+         {
+            continue;
+         }
+
+         auto& chainFile = chainFiles[i];
+         chainFile.path = files[i];
+         chainFile.entries = tree->GetEntries();
+
+         if(chainFile.entries > 0)
+         {
+            TimeBranchType time;
+            tree->SetBranchStatus("*", false);
+            tree->SetBranchStatus(timeBranchName.c_str(), true);
+            tree->SetBranchAddress(timeBranchName.c_str(), &time);
+
+            tree->GetEntry(0);
+            chainFile.firstTime = time;
+            chainFile.lastTime = time;
+
+            if(scanAll)
+            {
+               TimeBranchType previous = time;
+               for(long entry = 1; entry < chainFile.entries; entry++)
+               {
+                  tree->GetEntry(entry);
+                  chainFile.firstTime = std::min(chainFile.firstTime, time);
+                  chainFile.lastTime = std::max(chainFile.lastTime, time);
+                  chainFile.sorted = chainFile.sorted && previous <= time;
+                  previous = time;
+               }
+            }
+            else
+            {
+               // A last entry before the first shows a file out of order, other disorder is only found by scanAll
+               tree->GetEntry(chainFile.entries - 1);
+               chainFile.sorted = chainFile.firstTime <= time;
+               chainFile.firstTime = std::min(chainFile.firstTime, time);
+               chainFile.lastTime = std::max(chainFile.lastTime, time);
+            }
+         }
+
+         valid[i] = true;
+      }
+   };
+
+   std::vector<std::thread> workers;
+   for(int i = 0; i < defaultNumberThreads(threads); i++)
+   {
+      workers.emplace_back(read);
+   }
+   for(auto& worker : workers)
+   {
+      worker.join();
+   }
+
+   std::vector<Templated_ChainFile<TimeBranchType>> result;
+   for(size_t i = 0; i < files.size(); i++)
+   {
+      if(valid[i])
+      {
+         result.push_back(chainFiles[i]);
+      }
+      else
+      {
+         std::cout << "Skip file that cannot be read or has no tree " << treeName << ": " << files[i] << "\n";
+      }
+   }
+
+   return result;
+}
+
+// Adds files in order of their first timestamp with known entry counts, so the chain knows its exact size without opening them again
+template<class TimeBranchType = TimeNS>
+TChain* makeChain(std::string treeName, std::vector<Templated_ChainFile<TimeBranchType>> chainFiles)
+{
+   std::stable_sort(chainFiles.begin(), chainFiles.end(), [](const auto& a, const auto& b)
+   {
+      return a.firstTime < b.firstTime;
+   });
+
+   TChain* chain = new TChain(treeName.c_str());
+
+   long entries = 0;
+   int added = 0;
+   int overlapping = 0;
+   int unsorted = 0;
+   const Templated_ChainFile<TimeBranchType>* previous = nullptr;
+   for(const auto& chainFile : chainFiles)
+   {
+      if(chainFile.entries == 0)
+      {
+         continue;
+      }
+      if(previous != nullptr && chainFile.firstTime < previous->lastTime)
+      {
+         overlapping++;
+      }
+      if(!chainFile.sorted)
+      {
+         unsorted++;
+      }
+
+      chain->Add(chainFile.path.c_str(), chainFile.entries);
+      entries += chainFile.entries;
+      added++;
+      previous = &chainFile;
+   }
+
+   std::cout << "Add " << added << " files with " << entries << " entries to chain " << treeName << "\n";
+   if(overlapping > 0)
+   {
+      std::cout << "NOTE: " << overlapping << " files overlap in time with the previous file, rows out of order will be skipped\n";
+   }
+   if(unsorted > 0)
+   {
+      std::cout << "NOTE: " << unsorted << " files are not in time order, rows out of order will be skipped\n";
+   }
+
+   return chain;
+}
+
+template<class TimeBranchType = TimeNS>
+TChain* makeSortedChain(std::string treeName, std::string path, std::string regexStr = ".*", std::string timeBranchName = "time",
+   bool recursive = true, int threads = 0, bool scanAll = false)
+{
+   auto files = findFiles(path, regexStr, recursive, threads);
+   return makeChain<TimeBranchType>(treeName, readChainFiles<TimeBranchType>(files, treeName, timeBranchName, threads, scanAll));
+}
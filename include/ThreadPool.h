@@ -0,0 +1,117 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Fixed number of worker threads taking jobs in submission order.
+// The future of a job is ready after the job and everything it captured are destroyed, so the submitter may free what the job pointed to.
+class ThreadPool
+{
+public:
+   ThreadPool(int threads)
+   {
+      if(threads < 1)
+      {
+         throw std::runtime_error("Thread pool needs at least one thread");
+      }
+
+      for(int i = 0; i < threads; i++)
+      {
+         workers.emplace_back([this](){ work(); });
+      }
+   }
+
+   // Finishes the jobs submitted before
+   ~ThreadPool()
+   {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         stopping = true;
+      }
+      wakeUp.notify_all();
+
+      for(auto& worker : workers)
+      {
+         worker.join();
+      }
+   }
+
+   ThreadPool(const ThreadPool&) = delete;
+   ThreadPool& operator=(const ThreadPool&) = delete;
+
+   // Exceptions of the job are rethrown by the get of the future
+   std::future<void> submit(std::function<void()> job)
+   {
+      auto done = std::make_shared<std::promise<void>>();
+      std::future<void> future = done->get_future();
+
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         jobs.emplace_back(std::move(job), std::move(done));
+      }
+      wakeUp.notify_one();
+
+      return future;
+   }
+
+   int size() const
+   {
+      return workers.size();
+   }
+
+private:
+   void work()
+   {
+      while(true)
+      {
+         std::function<void()> job;
+         std::shared_ptr<std::promise<void>> done;
+         {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeUp.wait(lock, [this](){ return stopping || jobs.size() > 0; });
+            if(jobs.size() == 0)
+            {
+               return;
+            }
+
+            job = std::move(jobs.front().first);
+            done = std::move(jobs.front().second);
+            jobs.pop_front();
+         }
+
+         std::exception_ptr error;
+         try
+         {
+            job();
+         }
+         catch(...)
+         {
+            error = std::current_exception();
+         }
+         job = nullptr;
+
+         if(error)
+         {
+            done->set_exception(error);
+         }
+         else
+         {
+            done->set_value();
+         }
+      }
+   }
+
+   std::vector<std::thread> workers;
+
+   std::mutex mutex;
+   std::condition_variable wakeUp;
+   std::deque<std::pair<std::function<void()>, std::shared_ptr<std::promise<void>>>> jobs;
+   bool stopping = false;
+};
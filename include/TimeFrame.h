@@ -1,19 +1,38 @@
 #pragma once
 
 #include "TimeNS.h"
+#include "SpillWindow.h"
+#include "FileCatalog.h"
+#include "RowArena.h"
+#include "RowBlock.h"
+#include "BranchExpression.h"
+#include "LazyRow.h"
+#include "TimeFrameSource.h"
+#include "NativeFormat.h"
+#include "ThreadPool.h"
+#include "TimerWheel.h"
 
 #include "TTreeReader.h"
+#include "TTreePerfStats.h"
 #include "TChain.h"
 #include "TFile.h"
+#include "TEnv.h"
+#include "TROOT.h"
 
 #include <random>
 
 #include <functional>
 #include <list>
+#include <deque>
 #include <memory>
 #include <chrono>
 #include <iterator>
 #include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+#include <tuple>
+#include <unordered_map>
 
 
 template<class IDType, class TimeType, class RowType>
@@ -44,16 +63,20 @@ struct Templated_IndexTimeRow
    RowType row;
 };
 
+// The row is held by handle, so the entries of all ids at one time share a single decoded row
 template<class RowType, class StateType>
 struct Templated_RowState
 {
-   Templated_RowState(RowType r, StateType s)
-   : row(r), state(s)
+   using RowHandle = typename RowArena<RowType>::Handle;
+
+   Templated_RowState(RowHandle h, StateType s)
+   : handle(std::move(h)), row(*handle), state(s)
    {
 
    }
 
-   RowType row;
+   RowHandle handle;
+   const RowType& row;
    StateType state;
 };
 
@@ -71,26 +94,178 @@ struct Templated_TimeRowState
    StateType state;
 };
 
+// Part of a container, only valid while the container is not changed
+template<class Iterator>
+struct Templated_RangeView
+{
+   Templated_RangeView(Iterator first, Iterator last)
+   : first(first), last(last)
+   {
+
+   }
+
+   Iterator begin() const
+   {
+      return first;
+   }
+   Iterator end() const
+   {
+      return last;
+   }
+   size_t size() const
+   {
+      return std::distance(first, last);
+   }
+   bool empty() const
+   {
+      return first == last;
+   }
+   const auto& operator[](size_t i) const
+   {
+      return *std::next(first, i);
+   }
+   const auto& front() const
+   {
+      return *first;
+   }
+   const auto& back() const
+   {
+      return *std::prev(last);
+   }
+
+   Iterator first;
+   Iterator last;
+};
+
+// Declared fields of all states as contiguous columns, entry i of every column belongs to ids[i], ids are in ascending order.
+// The views point into the columns and are valid until the next snapshot.
+template<class IDType>
+struct Templated_StateColumns
+{
+   using ColumnView = Templated_RangeView<const double*>;
+
+   ColumnView column(int index) const
+   {
+      return ColumnView(values[index].data(), values[index].data() + values[index].size());
+   }
+   ColumnView column(const std::string& name) const
+   {
+      for(int i=0;i<names.size();i++)
+      {
+         if(names[i] == name)
+         {
+            return column(i);
+         }
+      }
+      throw std::runtime_error("No state column named " + name);
+   }
+
+   size_t size() const
+   {
+      return ids.size();
+   }
+
+   std::vector<IDType> ids;
+   std::vector<std::string> names;
+   std::vector<std::vector<double>> values;
+};
+
 // Wrapper class arround TTree to keep track which tree has next piece of data chronologically
-template<class RowReaderType, class IdBranchType, class TimeBranchType>
-struct TimeFrameTree
+template<class RowType, class RowReaderType, class IdBranchType, class TimeBranchType>
+struct TimeFrameTree : public TimeFrameSource<RowType, IdBranchType, TimeBranchType>
 {
+   using Source = TimeFrameSource<RowType, IdBranchType, TimeBranchType>;
+   using Source::hasNewRow;
+   using Source::id;
+   using Source::time;
+   using Source::filterSelected;
+   using Source::triggerSelected;
+   using Source::lastTime;
+   using Source::timeFrom;
+   using Source::messagesSkipped;
+
    TimeFrameTree(TTree* pTree, std::string idBranchName, std::string timeBranchName)
    :  tree(pTree),
+      idBranchName(idBranchName),
+      timeBranchName(timeBranchName),
       reader(tree),
-      id(reader, idBranchName.c_str()),
-      time(reader, timeBranchName.c_str()),
+      idValue(reader, idBranchName.c_str()),
+      timeValue(reader, timeBranchName.c_str()),
       rowReader(reader)
    {
-      lastTime = 0;
+
    }
 
-   void prepareFirst(const std::function<bool(IdBranchType)>& idFilter, const std::function<void()>& preFilterCallback)
+   ~TimeFrameTree()
    {
-      prepareNext(idFilter, preFilterCallback);
+      if(perfStats)
+      {
+         tree->SetPerfStats(nullptr);
+      }
    }
 
-   void prepareNext(const std::function<bool(IdBranchType)>& idFilter, const std::function<void()>& preFilterCallback)
+   // Every tree has its own cache, without a size given they share a budget of 512 MB with 8 to 64 MB each
+   void configureIO(const IOOptions& options, int numberSources) override
+   {
+      long long cacheSize = options.cacheSize;
+      if(cacheSize < 0)
+      {
+         cacheSize = std::clamp<long long>(512LL * 1024 * 1024 / std::max(1, numberSources), 8LL * 1024 * 1024, 64LL * 1024 * 1024);
+      }
+
+      tree->SetCacheSize(cacheSize);
+      if(cacheSize > 0)
+      {
+         if(options.cacheAllBranches)
+         {
+            tree->AddBranchToCache("*", true);
+            tree->StopCacheLearningPhase();
+         }
+         else
+         {
+            tree->SetCacheLearnEntries(options.learnEntries);
+         }
+      }
+
+      if(options.statistics && !perfStats)
+      {
+         perfStats = std::make_unique<TTreePerfStats>("ioperf", tree);
+      }
+   }
+
+   IOStatistics getIOStatistics() override
+   {
+      IOStatistics statistics;
+      if(perfStats)
+      {
+         perfStats->Finish();
+
+         statistics.bytesRead = perfStats->GetBytesRead();
+         statistics.readCalls = perfStats->GetReadCalls();
+         statistics.diskTime = perfStats->GetDiskTime();
+         statistics.unzipTime = perfStats->GetUnzipTime();
+      }
+      return statistics;
+   }
+
+   // Expressions are compiled for every tree, so they can read their branches through its reader
+   void setExpressions(const std::string& selectionStr, const std::string& filterStr, const std::string& triggerStr) override
+   {
+      if(selectionStr.size() > 0)
+      {
+         selection = std::make_unique<BranchExpression>(tree, reader, selectionStr);
+      }
+      if(filterStr.size() > 0)
+      {
+         filterExpression = std::make_unique<BranchExpression>(tree, reader, filterStr);
+      }
+      if(triggerStr.size() > 0)
+      {
+         triggerExpression = std::make_unique<BranchExpression>(tree, reader, triggerStr);
+      }
+   }
+
+   void prepareNext(const std::function<bool(IdBranchType)>& idFilter, const std::function<void()>& preFilterCallback) override
    {
       hasNewRow = reader.Next();
 
@@ -108,16 +283,20 @@ struct TimeFrameTree
             }
          }
 
-         if(idFilter(*id))
+         if(idFilter(*idValue) && timeFrom <= *timeValue && (!selection || (*selection)()))
          {
-            if(*time < lastTime)
+            if(*timeValue < lastTime)
             {
                messagesSkipped++;
                hasNewRow = reader.Next();
             }
             else
             {
-               lastTime = *time;
+               id = *idValue;
+               time = *timeValue;
+               lastTime = *timeValue;
+               filterSelected = filterExpression && (*filterExpression)();
+               triggerSelected = triggerExpression && (*triggerExpression)();
                break;
             }
          }
@@ -128,11 +307,48 @@ struct TimeFrameTree
       }
    }
 
-   long getNumberEntries()
+   RowType readRow() override
+   {
+      return rowReader.get();
+   }
+
+   // Files of the tree or chain, trees that are not read from a file cannot be identified
+   std::string getCacheKey() override
+   {
+      std::string key = std::string("tree:") + tree->GetName() + ":" + idBranchName + ":" + timeBranchName + ":" + typeid(RowReaderType).name();
+
+      if(reader.IsChain())
+      {
+         TObjArray* files = ((TChain*) tree)->GetListOfFiles();
+         for(int i = 0; files != nullptr && i < files->GetEntries(); i++)
+         {
+            key += ";" + sourceFileKey(files->At(i)->GetTitle());
+         }
+      }
+      else if(tree->GetCurrentFile() != nullptr)
+      {
+         key += ";" + sourceFileKey(tree->GetCurrentFile()->GetName());
+      }
+      else
+      {
+         return "";
+      }
+
+      return key;
+   }
+
+   long getNumberEntries() override
    {
       if(reader.IsChain())
       {
          TChain* chain = (TChain*) tree;
+
+         // Exact if every file was added with its number of entries, as the chain factory does for sorted chains
+         if(chain->GetEntriesFast() != TTree::kMaxEntries)
+         {
+            return chain->GetEntriesFast();
+         }
+
          return ((double) numberEntriesCounter) * chain->GetNtrees() / numberTreesCounted;
       }
       else
@@ -153,22 +369,24 @@ struct TimeFrameTree
    }
 
    TTree* tree;
+   std::string idBranchName;
+   std::string timeBranchName;
 
    TTreeReader reader;
 
-   TTreeReaderValue<IdBranchType> id;
-   TTreeReaderValue<TimeBranchType> time;
+   TTreeReaderValue<IdBranchType> idValue;
+   TTreeReaderValue<TimeBranchType> timeValue;
 
    RowReaderType rowReader;
 
-   bool hasNewRow = true;
+   std::unique_ptr<BranchExpression> selection;
+   std::unique_ptr<BranchExpression> filterExpression;
+   std::unique_ptr<BranchExpression> triggerExpression;
 
-   TimeBranchType lastTime;
+   std::unique_ptr<TTreePerfStats> perfStats;
 
    int numberTreesCounted = 0;
    long numberEntriesCounter = 0;
-
-   long messagesSkipped = 0;
 };
 
 template<class TimeType, class ItType, class getTimeType, class callbackType>
@@ -202,7 +420,17 @@ public:
    using IDTimeRow = Templated_IDTimeRow<IdBranchType, TimeBranchType, RowType>;
    using RowState = Templated_RowState<RowType, StateType>;
    using TimeRowState = Templated_TimeRowState<TimeBranchType, RowType, StateType>;
-   using IndexTimeRow = Templated_IndexTimeRow<TimeBranchType, RowType>;
+   using RowHandle = typename RowArena<RowType>::Handle;
+   using IndexTimeRow = Templated_IndexTimeRow<TimeBranchType, RowHandle>;
+   using RowWindow = std::deque<std::pair<TimeBranchType, RowHandle>>;
+   using RowWindowView = Templated_RangeView<typename RowWindow::const_iterator>;
+   using RowBlock = Templated_RowBlock<IdBranchType, TimeBranchType, RowType>;
+   using Source = TimeFrameSource<RowType, IdBranchType, TimeBranchType>;
+   using StateColumns = Templated_StateColumns<IdBranchType>;
+
+   using IdBranch = IdBranchType;
+   using TimeBranch = TimeBranchType;
+   using State = StateType;
 
    TimeFrame()
    {
@@ -211,6 +439,9 @@ public:
 
    ~TimeFrame()
    {
+      // A stream left early leaves an incomplete timeline
+      closeTimelineCache(false);
+
       if(!hasRun)
       {
          std::cout << "\n NOTE: TimeFrame object generated but not ran.\n";
@@ -219,12 +450,86 @@ public:
 
    void add(TTree* tree, std::string idBranchName = "id", std::string timeBranchName = "time")
    {
-      trees.emplace_back(std::make_unique<TimeFrameTree<RowReaderType, IdBranchType, TimeBranchType>>(tree, idBranchName, timeBranchName));
+      trees.emplace_back(std::make_unique<TimeFrameTree<RowType, RowReaderType, IdBranchType, TimeBranchType>>(tree, idBranchName, timeBranchName));
    }
    void add(TFile* pFile, std::string treeName, std::string idBranchName = "id", std::string timeBranchName = "time")
    {
       TTree* tree = (TTree*) pFile->Get(treeName.c_str());
-      trees.emplace_back(std::make_unique<TimeFrameTree<RowReaderType, IdBranchType, TimeBranchType>>(tree, idBranchName, timeBranchName));
+      trees.emplace_back(std::make_unique<TimeFrameTree<RowType, RowReaderType, IdBranchType, TimeBranchType>>(tree, idBranchName, timeBranchName));
+   }
+   void add(std::unique_ptr<Source> source)
+   {
+      trees.emplace_back(std::move(source));
+   }
+   // File in the native format, see NativeFormat.h
+   void addNative(std::string path)
+   {
+      trees.emplace_back(std::make_unique<NativeSource<RowType, IdBranchType, TimeBranchType>>(path));
+   }
+
+   // Only opens the files of the catalog that can hold rows within [from, till] for one of the ids
+   void add(const FileCatalog<IdBranchType, TimeBranchType>& catalog, TimeBranchType from, TimeBranchType till, std::set<IdBranchType> ids = {})
+   {
+      add(catalog.makeChain(from, till, ids), catalog.getIdBranchName(), catalog.getTimeBranchName());
+   }
+
+   // Keeps the merged and filtered stream of all sources in a native file in the directory, the first run writes it
+   // and later runs with the same sources, time range and selection read it instead of merging the sources.
+   // The id filter is part of the stream but cannot be compared, the key has to name it if one is set,
+   // without a key the cache is not used then. Runs with different id filters need different keys.
+   // Not possible with filter or trigger expressions, they need the branches of the sources.
+   void setTimelineCache(std::string directory, std::string key = "")
+   {
+      static_assert(IsNativeRow<RowType>, "The timeline cache needs trivially copyable, default constructible rows without lazy columns");
+
+      timelineCacheDirectory = directory;
+      timelineCacheKey = key;
+   }
+   // Adds a part of the id filter to a key set by the user, e.g. the shard of a worker.
+   // Without a key of the user the cache is not used with an id filter anyway.
+   void extendTimelineCacheKey(std::string part)
+   {
+      if(timelineCacheKey.size() > 0)
+      {
+         timelineCacheKey += "|" + part;
+      }
+   }
+
+   // Applies to every tree without options of its own
+   void setIOOptions(IOOptions options)
+   {
+      ioOptions = options;
+   }
+   // Options of a single tree, in the order the trees were added
+   void setIOOptions(int tree, IOOptions options)
+   {
+      treeIOOptions[tree] = options;
+   }
+   // Reads the baskets of the next cache fill in a separate thread, needs to be set before any file is opened
+   void setPrefetching(bool b)
+   {
+      gEnv->SetValue("TFile.AsyncPrefetching", b ? 1 : 0);
+   }
+   // Decompresses baskets in parallel, 0 uses all cores
+   void setImplicitMT(int threads)
+   {
+      if(threads < 0)
+      {
+         ROOT::DisableImplicitMT();
+      }
+      else
+      {
+         ROOT::EnableImplicitMT(threads);
+      }
+   }
+   std::vector<IOStatistics> getIOStatistics()
+   {
+      std::vector<IOStatistics> statistics;
+      for(auto& tree : trees)
+      {
+         statistics.push_back(tree->getIOStatistics());
+      }
+      return statistics;
    }
 
    void setProgressBar(bool b)
@@ -235,6 +540,7 @@ public:
    void setIdFilter(std::function<bool(IdBranchType)> func)
    {
       idFilter = func;
+      idFilterSet = true;
    }
    void setIdFilter(IdBranchType id)
    {
@@ -244,12 +550,37 @@ public:
    {
       setIdFilter([=](IdBranchType rowId){return ids.count(rowId) > 0;});
    }
+   std::function<bool(IdBranchType)> getIdFilter()
+   {
+      return idFilter;
+   }
+
+   // Only rows with from <= time < till are passed to row handlers, snapshots and triggers.
+   // Rows after till are still read as long as actions of triggers within the range need them.
+   void setTimeRange(TimeBranchType from, TimeBranchType till)
+   {
+      timeFrom = from;
+      timeTill = till;
+   }
+   // Rows within the warm-up before the start of the time range only update states and action windows,
+   // triggers are evaluated to carry their cooldown over but not recorded
+   void setWarmUp(TimeBranchType w)
+   {
+      warmUp = w;
+   }
 
    void setRowGenerator(std::function<std::optional<IDTimeRow>(IdBranchType, TimeBranchType, const RowType&, 
       IdBranchType, TimeBranchType, const RowType&)> func)
    {
       checkForGeneratedRow = func;
    }
+   // Fills the gap between two consecutive rows with any number of rows in one call, appended to the vector in time order.
+   // They are dispatched directly before the next row, which is not read again.
+   void setRowGenerator(std::function<void(IdBranchType, TimeBranchType, const RowType&,
+      IdBranchType, TimeBranchType, const RowType&, std::vector<IDTimeRow>&)> func)
+   {
+      generateRows = func;
+   }
 
    void setTrigger(std::function<bool(IdBranchType, TimeBranchType, const RowType&)> func)
    {
@@ -260,6 +591,44 @@ public:
       storeStates = true;
       triggerWithState = func;
    }
+   // Filter and trigger given as C++ expressions over branch names, e.g. "x > 1.5 && id == 3", compiled at runtime.
+   // They are evaluated on the branches they name before the row is read, generated rows are never selected by them.
+   // Rows neither expression selects are not read at all, unless a state updater, row handler, generator, pipeline
+   // or a function filter or trigger needs every row.
+   void setFilter(std::string expression)
+   {
+      filterExpression = expression;
+   }
+   void setTrigger(std::string expression)
+   {
+      triggerExpression = expression;
+   }
+   // Rows not matching the expression are skipped while reading, like rows of ids not passing the id filter:
+   // they neither update states nor reach any handler, and their row is never read
+   void setSelection(std::string expression)
+   {
+      selectionExpression = expression;
+   }
+
+   // Stateless filter and trigger evaluated on blocks of consecutive rows ahead of dispatch, they set the bits of the rows they select.
+   // Only one kind of filter and one kind of trigger may be set: a batch predicate, an expression or a function.
+   void setBatchFilter(std::function<void(const RowBlock&, SelectionMask&)> func)
+   {
+      batchFilter = func;
+   }
+   void setBatchTrigger(std::function<void(const RowBlock&, SelectionMask&)> func)
+   {
+      batchTrigger = func;
+   }
+   void setBatchSize(int size)
+   {
+      if(size < 1)
+      {
+         throw std::runtime_error("Batch size needs to be positive");
+      }
+      batchSize = size;
+   }
+
    void setTriggerCooldown(TimeBranchType t)
    {
       triggerCooldown = t;
@@ -269,6 +638,66 @@ public:
       return triggerCount;
    }
 
+   // Actions fire as soon as the stream passes the end of their window, instead of at the next row of their id.
+   // Only for windows ending at a time, not after a number of rows.
+   void setExactActionTiming(bool exact)
+   {
+      exactActionTiming = exact;
+   }
+
+   // Calls func with the time once the stream passes it, before the first row at or after the time
+   void schedule(TimeBranchType time, std::function<void(TimeBranchType)> func)
+   {
+      timerWheel.schedule(time, func, true);
+   }
+
+   // Trigger and action of its own next to the main one. The rows passing the filter are stored once for all pipelines,
+   // as far back as the widest window needs, and every action gets the rows within [time + from, time + till] of its trigger.
+   void addPipeline(std::string name, TimeBranchType from, TimeBranchType till,
+      std::function<bool(IdBranchType, TimeBranchType, const RowType&)> trigger,
+      std::function<void(IdBranchType, TimeBranchType, const RowType&, const RowWindowView&)> action,
+      TimeBranchType cooldown = 0)
+   {
+      if(from > till)
+      {
+         throw std::runtime_error("Window of pipeline " + name + " ends before it starts");
+      }
+      for(auto& pipeline : pipelines)
+      {
+         if(pipeline.name == name)
+         {
+            throw std::runtime_error("Pipeline " + name + " already exists");
+         }
+      }
+
+      Pipeline pipeline;
+      pipeline.name = name;
+      pipeline.from = from;
+      pipeline.till = till;
+      pipeline.cooldown = cooldown;
+      pipeline.trigger = trigger;
+      pipeline.action = action;
+
+      // Action threads need a window of their own
+      pipeline.actionOnCopy = [action](IdBranchType id, TimeBranchType time, const RowType& row, const RowWindow& window)
+      {
+         action(id, time, row, RowWindowView(window.begin(), window.end()));
+      };
+
+      pipelines.push_back(std::move(pipeline));
+   }
+   long getTriggerCount(std::string name)
+   {
+      for(auto& pipeline : pipelines)
+      {
+         if(pipeline.name == name)
+         {
+            return pipeline.triggerCount;
+         }
+      }
+      throw std::runtime_error("No pipeline " + name);
+   }
+
    void setForEachRow(std::function<void(IdBranchType, TimeBranchType, const RowType&)> func)
    {
       forEachRow = func;
@@ -326,6 +755,13 @@ public:
       tillBasedOnMessage = true;
       setAction(func);
    }
+   // Where and when rows of an action with a SpillWindow are moved out of memory
+   void setWindowSpilling(std::string directory, size_t hotRows, size_t segmentRows = 65536)
+   {
+      spillDirectory = directory;
+      spillHotRows = hotRows;
+      spillSegmentRows = segmentRows;
+   }
    void setActionResampled(TimeNS from, TimeNS till, TimeBranchType interval, std::function<void(IdBranchType, TimeBranchType, const RowType&, const StateType&,
       const std::list<TimeRowState>&)> func)
    {
@@ -366,128 +802,236 @@ public:
       forEachSnapshotAllStates = func;
    }
 
-   void run()
+   // Incremental snapshots: only the states updated since the previous snapshot
+   void setForEachChangedSnapshot(TimeNS w, std::function<void(IdBranchType, TimeBranchType, const StateType&)> func)
    {
-      try
-      {
-         hasRun = true;
+      windowSize = w;
+      forEachChangedSnapshot = func;
+   }
+   // All states with the ids updated since the previous snapshot, none if nothing changed
+   void setForEachSnapshotWithChanges(TimeNS w, std::function<void(TimeBranchType, const std::map<IdBranchType, StateType>&, const std::vector<IdBranchType>&)> func)
+   {
+      windowSize = w;
+      forEachChangedSnapshotAllStates = func;
+   }
 
-         auto preFilterCallback = [&](){
-            entriesProcessed++;
-            updateProgressBar(false);
-         };
+   // Columnar snapshots: a field of every state is kept in one array across the ids, for ranks, z-scores or sums over the universe.
+   // Only the entries of the states updated since the previous snapshot are extracted again. Returns the index of the column.
+   int addStateColumn(std::string name, std::function<double(const StateType&)> extractor)
+   {
+      stateColumns.names.push_back(name);
+      stateColumns.values.emplace_back(stateColumns.ids.size());
+      stateColumnExtractors.push_back(extractor);
+      stateColumnsLayoutChanged = true;
 
-         for(auto& tree : trees)
-         {
-            tree->prepareFirst(idFilter, preFilterCallback);   
-         }
+      return stateColumnExtractors.size() - 1;
+   }
+   void setForEachColumnSnapshot(TimeNS w, std::function<void(TimeBranchType, const StateColumns&)> func)
+   {
+      windowSize = w;
+      forEachColumnSnapshot = func;
+   }
 
-         startTime = std::chrono::steady_clock::now();
+   // A row of the merged stream, the selection flags are set by filter and trigger expressions
+   struct StreamEvent
+   {
+      IdBranchType id = IdBranchType();
+      TimeBranchType time = TimeBranchType();
+      RowHandle row;
+      bool filterSelected = false;
+      bool triggerSelected = false;
+   };
+
+   class StreamIterator
+   {
+   public:
+      using iterator_category = std::input_iterator_tag;
+      using value_type = StreamEvent;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const StreamEvent*;
+      using reference = const StreamEvent&;
+
+      StreamIterator(TimeFrame* f)
+      :  frame(f)
+      {
 
-         bool firstMessage = true;
-         IdBranchType lastId;
-         TimeBranchType lastTime;
-         RowType lastRow;
+      }
 
-         bool finished = false;
-         while((!finished) && (!stopRequested))
-         {
-            TimeBranchType earliestNextTime = std::numeric_limits<TimeBranchType>::max();
-            int earliestNextIndex = -1;
+      const StreamEvent& operator*() const
+      {
+         return frame->currentEvent();
+      }
+      const StreamEvent* operator->() const
+      {
+         return &frame->currentEvent();
+      }
+      StreamIterator& operator++()
+      {
+         frame->advanceStream();
+         return *this;
+      }
+      bool operator==(const StreamIterator& other) const
+      {
+         return atEnd() == other.atEnd();
+      }
+      bool operator!=(const StreamIterator& other) const
+      {
+         return atEnd() != other.atEnd();
+      }
 
-            // Select tree with the earliest next row
-            for(int i=0;i<trees.size();i++)
-            {
-               if(trees[i]->hasNewRow)
-               {
-                  if(*(trees[i]->time) < earliestNextTime)
-                  {
-                     earliestNextTime = *(trees[i]->time);
-                     earliestNextIndex = i;
-                  }
-               }
-            }
+   private:
+      bool atEnd() const
+      {
+         return frame == nullptr || frame->currentSource == -1 || frame->stopRequested;
+      }
 
-            if(earliestNextIndex != -1)
-            {
-               IdBranchType id = *(trees[earliestNextIndex]->id);
-               TimeBranchType time = *(trees[earliestNextIndex]->time);
+      TimeFrame* frame;
+   };
 
-               RowType row = trees[earliestNextIndex]->rowReader.get();
+   class Stream
+   {
+   public:
+      Stream(TimeFrame* f)
+      :  frame(f)
+      {
 
-               bool isRowGenerated = false;
-               if(!firstMessage && checkForGeneratedRow)
-               {
-                  std::optional<IDTimeRow> generatedRow = checkForGeneratedRow(lastId, lastTime, lastRow, id, time, row);
+      }
 
-                  if(generatedRow)
-                  {
-                     isRowGenerated = true;
+      StreamIterator begin() const
+      {
+         return StreamIterator(frame);
+      }
+      StreamIterator end() const
+      {
+         return StreamIterator(nullptr);
+      }
 
-                     id = generatedRow->id;
-                     time = generatedRow->time;
-                     row = generatedRow->row;
-                  }
-               }
+   private:
+      TimeFrame* frame;
+   };
+
+   // Pull based access to the merged stream: rows in time order after the id filter and the selection, from the start of the warm up,
+   // no handler is called. Leaving the loop stops reading, rows of lazy columns are valid until the iterator moves on.
+   //
+   // for(const auto& event : timeFrame.stream())
+   // {
+   //    sum += event.row->x;
+   // }
+   Stream stream()
+   {
+      startStream();
+      return Stream(this);
+   }
 
-               // Check if ID already seen before, init if not
-               checkForNewID(id);
+   // False if looping was aborted by an error, the results are incomplete then
+   bool run()
+   {
+      try
+      {
+         if(actionPool && actionWithStateSpilled)
+         {
+            throw std::runtime_error("Not supported: action threads with spilled windows");
+         }
 
-               // Check if action needs to be performed before this row updates the state
-               checkForAction(id, time);
+         startStream();
 
-               // Update the state with this row
-               checkForStateUpdate(id, time, row);
+         bool readSelectedOnly = onlySelectedRowsNeeded();
+         passUnselectedRows = (batchFilter || batchTrigger) && !everyRowHandled();
 
-               // Check for handlers of each row, independent of trigger - filter - action system
-               if(forEachRow) forEachRow(id, time, row);
-               if(forEachRowWithState) forEachRowWithState(id, time, row, currentStates.at(id));
-               if(forEachRowWithAllState) forEachRowWithAllState(id, time, row, currentStates);
+         while(currentSource != -1 && !stopRequested)
+         {
+            auto& source = trees[currentSource];
+            if(readSelectedOnly && !source->filterSelected && !source->triggerSelected)
+            {
+               // Only passes time for the windows, timers and cooldowns, the row is never read
+               processRow(source->id, source->time, RowHandle());
+               advanceStream();
+               continue;
+            }
 
-               // Check if this row is a filter or trigger
-               checkForFilter(id, time, row);
-               checkForTrigger(id, time, row);
+            const StreamEvent& event = currentEvent();
 
-               firstMessage = false;
-               lastId = id;
-               lastTime = time;
-               lastRow = row;
+            if(batchFilter || batchTrigger)
+            {
+               // Dispatched after the reader moved on
+               detachRow(*event.row);
+
+               block.push_back(event.id, event.time, event.row);
+               blockFilterSelected.push_back(event.filterSelected);
+               blockTriggerSelected.push_back(event.triggerSelected);
+               advanceStream();
 
-               if(!isRowGenerated)
+               if(block.size() >= batchSize)
                {
-                  trees[earliestNextIndex]->prepareNext(idFilter, preFilterCallback);
+                  dispatchBlock();
                }
             }
             else
             {
-               finished = true;
+               dispatchRow(event.id, event.time, event.row, event.filterSelected, event.triggerSelected);
+               advanceStream();
+            }
+         }
+
+         if(!stopRequested)
+         {
+            dispatchBlock();
+
+            if(streamEndTime < std::numeric_limits<TimeBranchType>::max())
+            {
+               // Every tree is time ordered, nothing within the range follows
+               streamTime = streamEndTime;
+               checkForSnapshot(streamEndTime);
             }
+            else if(streamTime < readTill)
+            {
+               streamTime = std::numeric_limits<TimeBranchType>::max();
+            }
+         }
+
+         // A stopped run has not seen all rows
+         closeTimelineCache(!stopRequested);
+
+         if(!stopRequested)
+         {
+            timerWheel.advance(streamTime);
          }
 
          for(auto& t : triggerData)
          {
             checkForAction(t.first, 0, true);
          }
+         for(auto& r : pipelineRows)
+         {
+            checkForPipelineActions(r.first, 0, true);
+         }
+         commitActions(true);
 
          updateProgressBar(true);
+         reportIOStatistics();
+         return true;
       }
       catch(std::out_of_range& error)
       {
+         closeTimelineCache(false);
          updateProgressBar(false);
 
          std::cout << "\n\n";
 
          std::cout << "Out of range error thrown in TimeFrame class while looping: " << error.what() << "\n";
          std::cout << "Looping is aborted, execution is incomplete.\n";
+         return false;
       }
       catch(std::runtime_error& error)
       {
+         closeTimelineCache(false);
          updateProgressBar(false);
 
          std::cout << "\n\n";
 
          std::cout << "Error thrown in TimeFrame class while looping: " << error.what() << "\n";
          std::cout << "Looping is aborted, execution is incomplete.\n";
+         return false;
       }
    }
 
@@ -500,32 +1044,535 @@ public:
    {
       return currentStates;
    }
+   // Columns as of the last snapshot
+   const StateColumns& getStateColumns()
+   {
+      return stateColumns;
+   }
 
    void requestStop()
    {
       stopRequested = true;
    }
 
+   // Actions run on a pool of threads while the rows are read on, with copies of their window and trigger data.
+   // Action handlers must only touch what they get passed, and hand their results to emitOrdered.
+   // Ordered runs the emitted results in the order the actions were triggered, otherwise in the order they finish.
+   // Not possible with spilled windows, 0 runs the actions right away again.
+   void setActionThreads(int threads, bool ordered = true)
+   {
+      // Actions left by a run that ended with an exception may still run, their arguments are released after the pool finished
+      actionPool.reset();
+      pendingActions.clear();
+
+      if(threads > 0)
+      {
+         actionPool = std::make_unique<ThreadPool>(threads);
+         maxPendingActions = threads * 16;
+      }
+      actionsOrdered = ordered;
+   }
+
+   // Runs func on the thread of run(), right away unless called from an action on the action threads
+   void emitOrdered(std::function<void()> func)
+   {
+      if(currentEmits)
+      {
+         currentEmits->push_back(std::move(func));
+      }
+      else
+      {
+         func();
+      }
+   }
+
+   long long getEntriesProcessed()
+   {
+      return entriesProcessed;
+   }
+   // Rows within the time range, without those of the warm-up and those read on for action windows
+   long long getRowsInRange()
+   {
+      return rowsInRange;
+   }
+   TimeNS getSnapshotWindow()
+   {
+      return windowSize;
+   }
+   // Rows of all sources skipped because they were before the previous row of their source
+   long long getMessagesSkipped()
+   {
+      long long skipped = 0;
+      for(auto& tree : trees)
+      {
+         skipped += tree->messagesSkipped;
+      }
+      return skipped;
+   }
+
+   // Time of the row being processed, the maximum time after the end of data
+   TimeBranchType getCurrentTime()
+   {
+      return streamTime;
+   }
+
 private:
+   // The windows of the list and state actions hold copies of their rows, as their types expose the row by value.
+   // RowWindow actions and the entries of the all state action share the decoded row by handle.
    void setAction(std::function<void(IdBranchType, TimeBranchType, const RowType&, const std::list<std::pair<TimeBranchType, RowType>>&)> func)
    {
       action = func;
    }
+   void setAction(std::function<void(IdBranchType, TimeBranchType, const RowType&, const RowWindow&)> func)
+   {
+      actionWithRowWindow = func;
+   }
    void setAction(std::function<void(IdBranchType, TimeBranchType, const RowType&, const StateType&,
       const std::list<TimeRowState>&)> func)
    {
       storeStates = true;
       actionWithState = func;
    }
-   void setAction(std::function<void(IdBranchType, TimeBranchType, const RowType&, const StateType&,
-      const std::list<std::pair<TimeBranchType, std::map<IdBranchType, RowState>>>&)> func)
+   void setAction(std::function<void(IdBranchType, TimeBranchType, const RowType&, const StateType&,
+      const SpillWindow<TimeRowState>&)> func)
+   {
+      static_assert(std::is_trivially_copyable_v<TimeRowState>, "Spilled action windows require trivially copyable rows and states");
+      storeStates = true;
+      actionWithStateSpilled = func;
+   }
+   void setAction(std::function<void(IdBranchType, TimeBranchType, const RowType&, const StateType&,
+      const std::list<std::pair<TimeBranchType, std::map<IdBranchType, RowState>>>&)> func)
+   {
+      if(fromBasedOnMessage || tillBasedOnMessage)
+      {
+         throw std::runtime_error("Not supported: all state action with message borders");
+      }
+      storeStates = true;
+      actionWithAllState = func;
+   }
+
+   void reportIOStatistics()
+   {
+      bool enabled = ioOptions.statistics;
+      for(auto& options : treeIOOptions)
+      {
+         enabled = enabled || options.second.statistics;
+      }
+      if(!enabled)
+      {
+         return;
+      }
+
+      for(int i=0;i<trees.size();i++)
+      {
+         IOStatistics statistics = trees[i]->getIOStatistics();
+
+         std::cout << "Tree " << i << " I/O: " << std::setprecision(1) << std::fixed << statistics.bytesRead / 1e6 << " MB in "
+            << statistics.readCalls << " reads | " << std::setprecision(2) << statistics.diskTime << " sec disk | "
+            << statistics.unzipTime << " sec decompression\n";
+      }
+   }
+
+   // Prepares the sources and selects the first row
+   void startStream()
+   {
+      // Otherwise one would silently take the place of the other
+      if((filterExpression.size() > 0) + (batchFilter != nullptr) + (filter || filterWithState) > 1)
+      {
+         throw std::runtime_error("More than one kind of filter set, use either an expression, a batch filter or a function");
+      }
+      if((triggerExpression.size() > 0) + (batchTrigger != nullptr) + (trigger || triggerWithState) > 1)
+      {
+         throw std::runtime_error("More than one kind of trigger set, use either an expression, a batch trigger or a function");
+      }
+
+      hasRun = true;
+
+      preFilterCallback = [this](){
+         entriesProcessed++;
+         updateProgressBar(false);
+      };
+
+      // Pending actions of triggers just before the end of the time range need the rows up to their window end
+      readTill = timeTill;
+      streamEndTime = std::numeric_limits<TimeBranchType>::max();
+
+      TimeBranchType reach = std::max<TimeBranchType>(till, 0);
+      for(auto& pipeline : pipelines)
+      {
+         reach = std::max(reach, pipeline.till);
+      }
+
+      if((action || actionWithRowWindow || actionWithState || actionWithStateSpilled || actionWithAllState || pipelines.size() > 0)
+         && timeTill != std::numeric_limits<TimeBranchType>::max())
+      {
+         if(tillBasedOnMessage || std::numeric_limits<TimeBranchType>::max() - reach <= timeTill)
+         {
+            readTill = std::numeric_limits<TimeBranchType>::max();
+         }
+         else
+         {
+            readTill = timeTill + reach;
+         }
+      }
+
+      TimeBranchType readFrom = timeFrom == std::numeric_limits<TimeBranchType>::lowest() ? timeFrom : timeFrom - warmUp;
+
+      bool cacheHit = false;
+      if(timelineCacheDirectory.size() > 0)
+      {
+         cacheHit = openTimelineCache(readFrom, readTill);
+      }
+
+      for(int i=0;i<trees.size();i++)
+      {
+         if(!cacheHit)
+         {
+            trees[i]->setExpressions(selectionExpression, filterExpression, triggerExpression);
+         }
+         trees[i]->configureIO(treeIOOptions.count(i) > 0 ? treeIOOptions[i] : ioOptions, trees.size());
+         trees[i]->timeFrom = readFrom;
+         trees[i]->prepareFirst(idFilter, preFilterCallback);
+      }
+
+      startTime = std::chrono::steady_clock::now();
+
+      firstMessage = true;
+
+      selectNextSource();
+   }
+
+   // Rows neither filter nor trigger expression selects are only needed by handlers that see every row
+   bool onlySelectedRowsNeeded() const
+   {
+      bool expressions = filterExpression.size() > 0 || triggerExpression.size() > 0;
+      bool filterOnSelection = filterExpression.size() > 0 || !(filter || filterWithState || batchFilter);
+      bool triggerOnSelection = triggerExpression.size() > 0 || !(trigger || triggerWithState || batchTrigger);
+
+      return expressions && filterOnSelection && triggerOnSelection && !everyRowHandled() && !timelineWriter;
+   }
+
+   // Handlers and predicates that are called with every row, not only with the selected ones
+   bool everyRowHandled() const
+   {
+      return stateUpdater || forEachRow || forEachRowWithState || forEachRowWithAllState
+         || generateRows || checkForGeneratedRow || pipelines.size() > 0
+         || filter || filterWithState || trigger || triggerWithState;
+   }
+
+   // Selects the tree with the earliest next row, none at the end of the data or of the range that is read
+   void selectNextSource()
+   {
+      TimeBranchType earliestNextTime = std::numeric_limits<TimeBranchType>::max();
+      currentSource = -1;
+      eventRead = false;
+
+      for(int i=0;i<trees.size();i++)
+      {
+         if(trees[i]->hasNewRow)
+         {
+            if(trees[i]->time < earliestNextTime)
+            {
+               earliestNextTime = trees[i]->time;
+               currentSource = i;
+            }
+         }
+      }
+
+      if(currentSource != -1 && earliestNextTime >= readTill)
+      {
+         streamEndTime = earliestNextTime;
+         currentSource = -1;
+      }
+
+      if(currentSource == -1)
+      {
+         closeTimelineCache(true);
+      }
+   }
+
+   // Row of the selected tree, decoded once: windows, trigger data and the last row only hold handles to it
+   const StreamEvent& currentEvent()
+   {
+      if(!eventRead)
+      {
+         auto& source = trees[currentSource];
+
+         streamEvent.id = source->id;
+         streamEvent.time = source->time;
+         streamEvent.row = rowArena.emplace(source->readRow());
+         streamEvent.filterSelected = source->filterSelected;
+         streamEvent.triggerSelected = source->triggerSelected;
+         eventRead = true;
+
+         if constexpr (IsNativeRow<RowType>)
+         {
+            if(timelineWriter)
+            {
+               timelineWriter->push_back(streamEvent.id, streamEvent.time, *streamEvent.row);
+            }
+         }
+      }
+
+      return streamEvent;
+   }
+
+   void advanceStream()
+   {
+      // Rows skipped by the consumer still belong to the timeline
+      if(timelineWriter)
+      {
+         currentEvent();
+      }
+
+      trees[currentSource]->prepareNext(idFilter, preFilterCallback);
+      selectNextSource();
+   }
+
+   // Replaces the sources by the cached timeline if it exists, otherwise prepares writing it while running
+   bool openTimelineCache(TimeBranchType readFrom, TimeBranchType readTill)
+   {
+      if constexpr (IsNativeRow<RowType>)
+      {
+         if(filterExpression.size() > 0 || triggerExpression.size() > 0)
+         {
+            std::cout << "NOTE: timeline cache not used, filter and trigger expressions need the sources\n";
+            return false;
+         }
+
+         if(idFilterSet && timelineCacheKey.size() == 0)
+         {
+            std::cout << "NOTE: timeline cache not used, an id filter is set but no key names it\n";
+            return false;
+         }
+
+         std::string key = timelineCacheKey + "|" + std::to_string(readFrom) + "|" + std::to_string(readTill) + "|" + selectionExpression;
+         for(auto& tree : trees)
+         {
+            std::string sourceKey = tree->getCacheKey();
+            if(sourceKey.size() == 0)
+            {
+               std::cout << "NOTE: timeline cache not used, a source cannot be identified\n";
+               return false;
+            }
+            key += "|" + sourceKey;
+         }
+
+         // FNV-1a, stable between runs
+         uint64_t hash = 14695981039346656037ULL;
+         for(char c : key)
+         {
+            hash = (hash ^ (unsigned char) c) * 1099511628211ULL;
+         }
+
+         std::ostringstream name;
+         name << timelineCacheDirectory << "/timeline_" << std::hex << std::setw(16) << std::setfill('0') << hash << ".native";
+         timelineCachePath = name.str();
+
+         if(std::filesystem::exists(timelineCachePath))
+         {
+            std::cout << "Read timeline from cache " << timelineCachePath << "\n";
+
+            trees.clear();
+            trees.emplace_back(std::make_unique<NativeSource<RowType, IdBranchType, TimeBranchType>>(timelineCachePath));
+            return true;
+         }
+
+         std::cout << "Write timeline to cache " << timelineCachePath << "\n";
+         timelineWriter = std::make_unique<NativeWriter<RowType, IdBranchType, TimeBranchType>>(timelineCachePath + ".tmp" + std::to_string(getpid()));
+      }
+
+      return false;
+   }
+
+   // Only a complete timeline becomes visible, renaming is atomic
+   void closeTimelineCache(bool complete)
+   {
+      if(!timelineWriter)
+      {
+         return;
+      }
+
+      std::string tmpPath = timelineCachePath + ".tmp" + std::to_string(getpid());
+      try
+      {
+         timelineWriter->close();
+         timelineWriter.reset();
+
+         if(complete)
+         {
+            std::filesystem::rename(tmpPath, timelineCachePath);
+            return;
+         }
+      }
+      catch(std::exception& error)
+      {
+         std::cout << "Cannot write timeline cache: " << error.what() << "\n";
+         timelineWriter.reset();
+      }
+
+      std::error_code error;
+      std::filesystem::remove(tmpPath, error);
+   }
+
+   // Evaluates the batch predicates on the collected rows at once, then dispatches them one by one
+   void dispatchBlock()
+   {
+      if(block.size() == 0)
+      {
+         return;
+      }
+
+      evaluateBlock(block, filterMask, triggerMask);
+
+      size_t i = 0;
+      for(; i < block.size() && !stopRequested; i++)
+      {
+         bool filterSelected = batchFilter ? filterMask.test(i) : blockFilterSelected[i];
+         bool triggerSelected = batchTrigger ? triggerMask.test(i) : blockTriggerSelected[i];
+
+         if(passUnselectedRows && !filterSelected && !triggerSelected)
+         {
+            passRow(block.ids[i], block.times[i]);
+         }
+         else
+         {
+            dispatchRow(block.ids[i], block.times[i], block.rows[i], filterSelected, triggerSelected);
+         }
+      }
+
+      // Rows read ahead into the block are only processed once dispatched, those left after a stop are not
+      entriesProcessed -= block.size() - i;
+
+      block.clear();
+      blockFilterSelected.clear();
+      blockTriggerSelected.clear();
+   }
+
+   void evaluateBlock(const RowBlock& rows, SelectionMask& filterSelection, SelectionMask& triggerSelection)
+   {
+      if(batchFilter)
+      {
+         filterSelection.reset(rows.size());
+         batchFilter(rows, filterSelection);
+      }
+      if(batchTrigger)
+      {
+         triggerSelection.reset(rows.size());
+         batchTrigger(rows, triggerSelection);
+      }
+   }
+
+   // Dispatches the rows generated for the gap since the last row, then the row itself
+   void dispatchRow(IdBranchType id, TimeBranchType time, const RowHandle& row, bool filterSelected = false, bool triggerSelected = false)
+   {
+      if(!firstMessage && generateRows)
+      {
+         generatedRows.clear();
+         generateRows(lastId, lastTime, *lastRow, id, time, *row, generatedRows);
+
+         for(auto& generatedRow : generatedRows)
+         {
+            processGeneratedRow(std::move(generatedRow));
+         }
+      }
+
+      // Called again with every generated row as the last row until it has nothing to add
+      if(!firstMessage && checkForGeneratedRow)
+      {
+         std::optional<IDTimeRow> generatedRow;
+         while((generatedRow = checkForGeneratedRow(lastId, lastTime, *lastRow, id, time, *row)))
+         {
+            processGeneratedRow(std::move(*generatedRow));
+         }
+      }
+
+      processRow(id, time, row, filterSelected, triggerSelected);
+   }
+
+   // A row nothing selected and no handler sees, it only moves the stream on: due timers and actions of its id,
+   // which processRow would do as well
+   void passRow(IdBranchType id, TimeBranchType time)
+   {
+      streamTime = time;
+      timerWheel.advance(time);
+
+      checkForNewID(id);
+      checkForAction(id, time);
+
+      if(timeFrom <= time && time < timeTill)
+      {
+         rowsInRange++;
+      }
+
+      firstMessage = false;
+      lastId = id;
+      lastTime = time;
+   }
+
+   // Generated rows are not part of a block, batch predicates are evaluated on them one at a time
+   void processGeneratedRow(IDTimeRow&& generatedRow)
+   {
+      RowHandle row = rowArena.emplace(std::move(generatedRow.row));
+
+      if(batchFilter || batchTrigger)
+      {
+         RowBlock single;
+         SelectionMask filterSelection;
+         SelectionMask triggerSelection;
+
+         single.push_back(generatedRow.id, generatedRow.time, row);
+         evaluateBlock(single, filterSelection, triggerSelection);
+
+         processRow(generatedRow.id, generatedRow.time, row, batchFilter && filterSelection.test(0), batchTrigger && triggerSelection.test(0));
+      }
+      else
+      {
+         processRow(generatedRow.id, generatedRow.time, row);
+      }
+   }
+
+   void processRow(IdBranchType id, TimeBranchType time, const RowHandle& row, bool filterSelected = false, bool triggerSelected = false)
    {
-      if(fromBasedOnMessage || tillBasedOnMessage)
+      streamTime = time;
+
+      // Actions of windows ended before this row and scheduled callbacks
+      timerWheel.advance(time);
+
+      // Check if ID already seen before, init if not
+      checkForNewID(id);
+
+      // Check if action needs to be performed before this row updates the state
+      checkForAction(id, time);
+      checkForPipelineActions(id, time);
+
+      // Update the state with this row
+      checkForStateUpdate(id, time, *row);
+
+      // Check for handlers of each row, independent of trigger - filter - action system
+      if(timeFrom <= time && time < timeTill)
       {
-         throw std::runtime_error("Not supported: all state action with message borders");
+         rowsInRange++;
+         if(forEachRow) forEachRow(id, time, *row);
+         if(forEachRowWithState) forEachRowWithState(id, time, *row, currentStates.at(id));
+         if(forEachRowWithAllState) forEachRowWithAllState(id, time, *row, currentStates);
+      }
+
+      // Check if this row is a filter or trigger
+      checkForFilter(id, time, row, filterSelected);
+      checkForTrigger(id, time, row, triggerSelected);
+      checkForPipelineTriggers(id, time, row);
+
+      firstMessage = false;
+      lastId = id;
+      lastTime = time;
+      lastRow = row;
+
+      // Passed to the generators at the next row
+      if(generateRows || checkForGeneratedRow)
+      {
+         detachRow(*row);
       }
-      storeStates = true;
-      actionWithAllState = func;
    }
 
    void checkForNewID(IdBranchType currentId)
@@ -541,10 +1588,18 @@ private:
          {
             rows[currentId] = std::list<std::pair<TimeBranchType, RowType>>();
          }
+         else if(actionWithRowWindow)
+         {
+            rowWindows[currentId] = RowWindow();
+         }
          else if(actionWithState)
          {
             rowStates[currentId] = std::list<TimeRowState>();
          }
+         else if(actionWithStateSpilled)
+         {
+            rowStatesSpilled.try_emplace(currentId, spillDirectory, spillHotRows, spillSegmentRows);
+         }
          else if(actionWithAllState)
          {
             // Adding a new ID desyncs the state, clean them
@@ -554,6 +1609,13 @@ private:
          if(stateInitializer)
          {
             currentStates.emplace(currentId, stateInitializer(currentId));
+
+            // A new state is a change as well
+            if(tracksChanges())
+            {
+               markChanged(currentId);
+            }
+            stateColumnsLayoutChanged = true;
          }
       }
    }
@@ -617,6 +1679,23 @@ private:
             }
          }
       }
+      else if(actionWithRowWindow)
+      {
+         auto& window = rowWindows[currentId];
+         while(window.size() > keepPreWindowRows)
+         {
+            if((!fromBasedOnMessage && window[keepPreWindowRows].first - from < triggerTime)
+               || (fromBasedOnMessage && *std::next(rowsIndex[currentId].begin(), keepPreWindowRows) - fromMessage < triggerIndex))
+            {
+               window.pop_front();
+               rowsIndex[currentId].pop_front();
+            }
+            else
+            {
+               break;
+            }
+         }
+      }
       else if(actionWithState)
       {
          while(rowStates[currentId].size() > keepPreWindowRows)
@@ -633,6 +1712,23 @@ private:
             }
          }
       }
+      else if(actionWithStateSpilled)
+      {
+         auto& window = rowStatesSpilled.at(currentId);
+         while(window.size() > keepPreWindowRows)
+         {
+            if((!fromBasedOnMessage && std::next(window.begin(), keepPreWindowRows)->time - from < triggerTime)
+               || (fromBasedOnMessage && *std::next(rowsIndex[currentId].begin(), keepPreWindowRows) - fromMessage < triggerIndex))
+            {
+               window.pop_front();
+               rowsIndex[currentId].pop_front();
+            }
+            else
+            {
+               break;
+            }
+         }
+      }
       else if(actionWithAllState)
       {
          while(rowAllStates.size() > keepPreWindowRows)
@@ -654,18 +1750,25 @@ private:
       // This will also trigger if there are 0 rows within the window
       if(action)
       {
-         action(currentId,
+         invokeAction(action, currentId,
             triggerData[currentId].front().time,
-            triggerData[currentId].front().row,
+            *triggerData[currentId].front().row,
             rows[currentId]);
       }
+      else if(actionWithRowWindow)
+      {
+         invokeAction(actionWithRowWindow, currentId,
+            triggerData[currentId].front().time,
+            *triggerData[currentId].front().row,
+            rowWindows[currentId]);
+      }
       else if(actionWithState)
       {
          if(!resampleAction)
          {
-            actionWithState(currentId,
+            invokeAction(actionWithState, currentId,
                triggerData[currentId].front().time,
-               triggerData[currentId].front().row,
+               *triggerData[currentId].front().row,
                triggerStates[currentId].front(),
                rowStates[currentId]);
          }
@@ -700,9 +1803,9 @@ private:
                      rowsResampled.emplace_back(lastAdded, i->row, i->state);
                   }
 
-                  actionWithState(currentId,
+                  invokeAction(actionWithState, currentId,
                      triggerData[currentId].front().time,
-                     triggerData[currentId].front().row,
+                     *triggerData[currentId].front().row,
                      triggerStates[currentId].front(),
                      rowsResampled);
                }
@@ -714,13 +1817,21 @@ private:
             }
          }
       }
+      else if(actionWithStateSpilled)
+      {
+         actionWithStateSpilled(currentId,
+            triggerData[currentId].front().time,
+            *triggerData[currentId].front().row,
+            triggerStates[currentId].front(),
+            rowStatesSpilled.at(currentId));
+      }
       else if(actionWithAllState)
       {
          if(!resampleAction)
          {
-            actionWithAllState(currentId,
+            invokeAction(actionWithAllState, currentId,
                triggerData[currentId].front().time,
-               triggerData[currentId].front().row,
+               *triggerData[currentId].front().row,
                triggerStates[currentId].front(),
                rowAllStates);
          }
@@ -757,9 +1868,9 @@ private:
                      rowsResampled.emplace_back(lastAdded, i->second);
                   }
 
-                  actionWithAllState(currentId,
+                  invokeAction(actionWithAllState, currentId,
                      triggerData[currentId].front().time,
-                     triggerData[currentId].front().row,
+                     *triggerData[currentId].front().row,
                      triggerStates[currentId].front(),
                      rowsResampled);
                }
@@ -773,123 +1884,434 @@ private:
       }
    }
 
+   // Calls the action handler, or with action threads hands it copies of its arguments and continues
+   template<class Handler, class... Args>
+   void invokeAction(const Handler& handler, const Args&... args)
+   {
+      if(!actionPool)
+      {
+         handler(args...);
+         return;
+      }
+
+      // Copied on this thread, handles of rows may only be copied and released here
+      PendingAction& pending = pendingActions.emplace_back();
+      auto arguments = std::make_shared<std::tuple<std::decay_t<Args>...>>(args...);
+      pending.arguments = arguments;
+
+      const Handler* h = &handler;
+      auto* argumentsPointer = arguments.get();
+      auto* emits = &pending.emits;
+      pending.done = actionPool->submit([h, argumentsPointer, emits]()
+      {
+         currentEmits = emits;
+         std::apply(*h, *argumentsPointer);
+         currentEmits = nullptr;
+      });
+
+      commitActions(false);
+   }
+
+   // Runs the outputs of finished actions, in trigger order if ordered.
+   // Waits for the oldest action while too many are pending, and for all when finishing.
+   void commitActions(bool finish)
+   {
+      auto it = pendingActions.begin();
+      while(it != pendingActions.end())
+      {
+         bool wait = finish || pendingActions.size() > maxPendingActions;
+         if(!wait && it->done.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+         {
+            if(actionsOrdered)
+            {
+               break;
+            }
+            it++;
+            continue;
+         }
+
+         // Rethrows errors of the action
+         it->done.get();
+
+         for(auto& emit : it->emits)
+         {
+            emit();
+         }
+         it = pendingActions.erase(it);
+      }
+   }
+
+   // Calls the actions of the pipelines whose window ended before the current row, then drops the rows no window can reach anymore
+   void checkForPipelineActions(IdBranchType currentId, TimeBranchType currentTime, bool endOfTree = false)
+   {
+      if(pipelines.size() == 0)
+      {
+         return;
+      }
+
+      RowWindow& window = pipelineRows[currentId];
+      TimeBranchType keepFrom = std::numeric_limits<TimeBranchType>::max();
+
+      for(auto& pipeline : pipelines)
+      {
+         auto& pending = pipeline.pending[currentId];
+         while(pending.size() > 0 && (endOfTree || pending.front().first + pipeline.till < currentTime))
+         {
+            TimeBranchType triggerTime = pending.front().first;
+            auto first = std::lower_bound(window.cbegin(), window.cend(), triggerTime + pipeline.from,
+               [](const std::pair<TimeBranchType, RowHandle>& r, TimeBranchType t){ return r.first < t; });
+            auto last = std::upper_bound(first, window.cend(), triggerTime + pipeline.till,
+               [](TimeBranchType t, const std::pair<TimeBranchType, RowHandle>& r){ return t < r.first; });
+
+            if(actionPool)
+            {
+               invokeAction(pipeline.actionOnCopy, currentId, triggerTime, *pending.front().second, RowWindow(first, last));
+            }
+            else
+            {
+               pipeline.action(currentId, triggerTime, *pending.front().second, RowWindowView(first, last));
+            }
+
+            pending.pop_front();
+         }
+
+         // Rows before the window of the oldest pending trigger or of a trigger at the current row are not needed anymore
+         TimeBranchType earliest = pending.size() > 0 ? pending.front().first : currentTime;
+         keepFrom = std::min(keepFrom, earliest + pipeline.from);
+      }
+
+      while(window.size() > 0 && (endOfTree || window.front().first < keepFrom))
+      {
+         window.pop_front();
+      }
+   }
+
+   void checkForPipelineTriggers(IdBranchType currentId, TimeBranchType currentTime, const RowHandle& row)
+   {
+      if(currentTime >= timeTill)
+      {
+         return;
+      }
+
+      for(auto& pipeline : pipelines)
+      {
+         auto lastTrigger = pipeline.lastTrigger.find(currentId);
+         if(lastTrigger != pipeline.lastTrigger.end() && currentTime < lastTrigger->second + pipeline.cooldown)
+         {
+            continue;
+         }
+
+         if(pipeline.trigger(currentId, currentTime, *row))
+         {
+            pipeline.lastTrigger[currentId] = currentTime;
+
+            // During the warm-up only the cooldown is tracked
+            if(timeFrom <= currentTime)
+            {
+               detachRow(*row);
+               pipeline.pending[currentId].emplace_back(currentTime, row);
+               pipeline.triggerCount++;
+
+               if(exactActionTiming && std::numeric_limits<TimeBranchType>::max() - pipeline.till > currentTime)
+               {
+                  timerWheel.schedule(currentTime + pipeline.till, [this, currentId](TimeBranchType){ checkForPipelineActions(currentId, streamTime); });
+               }
+            }
+         }
+      }
+   }
+
    void checkForStateUpdate(IdBranchType currentId, TimeBranchType currentTime, const RowType& row)
    {
       if(stateUpdater)
       {
-         if(forEachSnapshot || forEachSnapshotAllStates)
+         checkForSnapshot(currentTime);
+
+         stateUpdater(currentId, currentTime, currentStates.at(currentId), row);
+
+         if(tracksChanges())
+         {
+            markChanged(currentId);
+         }
+      }
+   }
+
+   // The flag of every id is created with its state, so marking an id neither allocates nor searches a tree
+   void markChanged(IdBranchType currentId)
+   {
+      char& changed = changedFlags[currentId];
+      if(!changed)
+      {
+         changed = true;
+         changedIds.push_back(currentId);
+      }
+   }
+
+   // Snapshots of all window borders passed before the current time, only those within the time range are passed on
+   void checkForSnapshot(TimeBranchType currentTime)
+   {
+      if(stateUpdater && (forEachSnapshot || forEachSnapshotAllStates || tracksChanges()))
+      {
+         if(lastWindow == 0)
+         {
+            lastWindow = (TimeNS)(currentTime / windowSize);
+         }
+
+         while(lastWindow < (TimeNS)(currentTime / windowSize))
          {
-            if(lastWindow == 0)
+            lastWindow++;
+
+            if(lastWindow * windowSize < timeFrom || timeTill <= lastWindow * windowSize)
+            {
+               continue;
+            }
+
+            if(forEachSnapshot)
+            {
+               for(const auto& [key, security] : currentStates)
+               {
+                  forEachSnapshot(key, lastWindow * windowSize, security);
+               }
+            }
+
+            if(forEachSnapshotAllStates)
             {
-               lastWindow = (TimeNS)(currentTime / windowSize);
+               forEachSnapshotAllStates(lastWindow * windowSize, currentStates);
             }
 
-            while(lastWindow < (TimeNS)(currentTime / windowSize))
+            // Updates during the warm-up are passed with the first snapshot
+            if(tracksChanges())
             {
-               lastWindow++;
+               std::sort(changedIds.begin(), changedIds.end());
+
+               if(forEachColumnSnapshot)
+               {
+                  updateStateColumns();
+                  forEachColumnSnapshot(lastWindow * windowSize, stateColumns);
+               }
 
-               if(forEachSnapshot)
+               if(forEachChangedSnapshot)
                {
-                  for(const auto& [key, security] : currentStates)
+                  for(const auto& id : changedIds)
                   {
-                     forEachSnapshot(key, lastWindow * windowSize, security);
+                     forEachChangedSnapshot(id, lastWindow * windowSize, currentStates.at(id));
                   }
                }
 
-               if(forEachSnapshotAllStates)
+               if(forEachChangedSnapshotAllStates)
+               {
+                  forEachChangedSnapshotAllStates(lastWindow * windowSize, currentStates, changedIds);
+               }
+
+               for(const auto& id : changedIds)
                {
-                  forEachSnapshotAllStates(lastWindow * windowSize, currentStates);
+                  changedFlags[id] = false;
                }
+               changedIds.clear();
             }
          }
+      }
+   }
 
-         stateUpdater(currentId, currentTime, currentStates.at(currentId), row);
+   // Snapshots that need the ids updated since the previous one
+   bool tracksChanges() const
+   {
+      return forEachChangedSnapshot || forEachChangedSnapshotAllStates || forEachColumnSnapshot;
+   }
+
+   // New ids rebuild the columns in the order of the states, otherwise only the changed entries are extracted
+   void updateStateColumns()
+   {
+      if(stateColumnsLayoutChanged)
+      {
+         stateColumnsLayoutChanged = false;
+
+         stateColumns.ids.clear();
+         for(auto& column : stateColumns.values)
+         {
+            column.clear();
+         }
+
+         for(const auto& [id, state] : currentStates)
+         {
+            stateColumns.ids.push_back(id);
+            for(int c=0;c<stateColumnExtractors.size();c++)
+            {
+               stateColumns.values[c].push_back(stateColumnExtractors[c](state));
+            }
+         }
+         return;
+      }
+
+      // Both are in ascending order of the ids
+      auto slot = stateColumns.ids.begin();
+      for(const auto& id : changedIds)
+      {
+         slot = std::lower_bound(slot, stateColumns.ids.end(), id);
+         size_t i = slot - stateColumns.ids.begin();
+
+         const StateType& state = currentStates.at(id);
+         for(int c=0;c<stateColumnExtractors.size();c++)
+         {
+            stateColumns.values[c][i] = stateColumnExtractors[c](state);
+         }
       }
    }
 
-   void checkForFilter(IdBranchType currentId, TimeBranchType currentTime, const RowType& row)
+   void checkForFilter(IdBranchType currentId, TimeBranchType currentTime, const RowHandle& row, bool selected)
    {
-      if(filterWithState)
+      if(batchFilter || filterExpression.size() > 0)
+      {
+         if(selected)
+         {
+            storeRow(currentId, currentTime, row);
+         }
+      }
+      else if(filterWithState)
       {
-         if(filterWithState(currentId, currentTime, row, currentStates.at(currentId)))
+         if(filterWithState(currentId, currentTime, *row, currentStates.at(currentId)))
          {
             storeRow(currentId, currentTime, row);
          }
       }
       else if(filter)
       {
-         if(filter(currentId, currentTime, row))
+         if(filter(currentId, currentTime, *row))
          {
             storeRow(currentId, currentTime, row);
          }
       }
    }
 
-   void storeRow(IdBranchType currentId, TimeBranchType currentTime, const RowType& row)
+   void storeRow(IdBranchType currentId, TimeBranchType currentTime, const RowHandle& row)
    {
+      detachRow(*row);
+
+      if(pipelines.size() > 0)
+      {
+         pipelineRows[currentId].emplace_back(currentTime, row);
+      }
+
       if(action)
       {
          rowsIndex[currentId].emplace_back(actionCount[currentId]);
-         rows[currentId].emplace_back(currentTime, row);
+         rows[currentId].emplace_back(currentTime, *row);
+         actionCount[currentId]++;
+      }
+      else if(actionWithRowWindow)
+      {
+         rowsIndex[currentId].emplace_back(actionCount[currentId]);
+         rowWindows[currentId].emplace_back(currentTime, row);
          actionCount[currentId]++;
       }
       else if(actionWithState)
       {
          rowsIndex[currentId].emplace_back(actionCount[currentId]);
-         rowStates[currentId].emplace_back(currentTime, row, currentStates.at(currentId));
+         rowStates[currentId].emplace_back(currentTime, *row, currentStates.at(currentId));
+         actionCount[currentId]++;
+      }
+      else if(actionWithStateSpilled)
+      {
+         rowsIndex[currentId].emplace_back(actionCount[currentId]);
+         rowStatesSpilled.at(currentId).emplace_back(currentTime, *row, currentStates.at(currentId));
          actionCount[currentId]++;
       }
       else if(actionWithAllState)
       {
          std::map<IdBranchType, RowState> rowAllState;
 
-         for(auto c : currentStates)
+         for(const auto& c : currentStates)
          {
             rowAllState.emplace(c.first, RowState(row, c.second));
          }
 
-         rowAllStates.emplace_back(currentTime, rowAllState);
+         rowAllStates.emplace_back(currentTime, std::move(rowAllState));
          actionCount[currentId]++;
       }
    }
 
-   void checkForTrigger(IdBranchType currentId, TimeBranchType currentTime, const RowType& row)
+   void checkForTrigger(IdBranchType currentId, TimeBranchType currentTime, const RowHandle& row, bool selected)
    {
       // actionCount[currentId] - 1 because triggers donts have unique indices, but are aligned with the last known action row.
       // and to avoid that if a single row is both an action and a trigger, it is not counted twice
 
+      if(currentTime >= timeTill)
+      {
+         return;
+      }
+
+      // During the warm-up only the cooldown is tracked
+      bool record = timeFrom <= currentTime;
+
       if(lastTrigger[currentId] + triggerCooldown <= currentTime)
       {
          //if((!fromBasedOnMessage && true) // TODO: add a fence to only allow triggers if suificient data is available
          //   || (fromBasedOnMessage && -fromMessage < actionCount[currentId] - 1))
          {
-            if(triggerWithState)
+            if(batchTrigger || triggerExpression.size() > 0)
             {
-               if(triggerWithState(currentId, currentTime, row, currentStates.at(currentId)))
+               if(selected)
                {
                   lastTrigger[currentId] = currentTime;
-                  triggerData[currentId].emplace_back(actionCount[currentId] - 1, currentTime, row);
-                  triggerStates[currentId].emplace_back(currentStates.at(currentId));
-                  triggerCount++;
+                  if(record)
+                  {
+                     detachRow(*row);
+                     triggerData[currentId].emplace_back(actionCount[currentId] - 1, currentTime, row);
+                     scheduleAction(currentId, currentTime);
+                     if(actionWithState || actionWithStateSpilled || actionWithAllState)
+                     {
+                        triggerStates[currentId].emplace_back(currentStates.at(currentId));
+                     }
+                     triggerCount++;
+                  }
                }
             }
-            else if(trigger)
+            else if(triggerWithState)
             {
-               if(trigger(currentId, currentTime, row))
+               if(triggerWithState(currentId, currentTime, *row, currentStates.at(currentId)))
                {
                   lastTrigger[currentId] = currentTime;
-                  triggerData[currentId].emplace_back(actionCount[currentId] - 1, currentTime, row);
-                  if(actionWithState || actionWithAllState)
+                  if(record)
                   {
+                     detachRow(*row);
+                     triggerData[currentId].emplace_back(actionCount[currentId] - 1, currentTime, row);
+                     scheduleAction(currentId, currentTime);
                      triggerStates[currentId].emplace_back(currentStates.at(currentId));
+                     triggerCount++;
+                  }
+               }
+            }
+            else if(trigger)
+            {
+               if(trigger(currentId, currentTime, *row))
+               {
+                  lastTrigger[currentId] = currentTime;
+                  if(record)
+                  {
+                     detachRow(*row);
+                     triggerData[currentId].emplace_back(actionCount[currentId] - 1, currentTime, row);
+                     scheduleAction(currentId, currentTime);
+                     if(actionWithState || actionWithStateSpilled || actionWithAllState)
+                     {
+                        triggerStates[currentId].emplace_back(currentStates.at(currentId));
+                     }
+                     triggerCount++;
                   }
-                  triggerCount++;
                }
             }
          }
       }
    }
 
+   // The action is due once the stream passes the end of the window, as it is at the next row of its id
+   void scheduleAction(IdBranchType currentId, TimeBranchType triggerTime)
+   {
+      if(exactActionTiming && !tillBasedOnMessage && std::numeric_limits<TimeBranchType>::max() - till > triggerTime)
+      {
+         timerWheel.schedule(triggerTime + till, [this, currentId](TimeBranchType){ checkForAction(currentId, streamTime); });
+      }
+   }
+
    void updateProgressBar(bool finished)
    {
       if(showProgess)
@@ -916,6 +2338,10 @@ private:
                rowsInMemory += ri.second.size();
             }
             rowsInMemory += rowAllStates.size();
+            for(auto& rs : rowStatesSpilled)
+            {
+               rowsInMemory -= rs.second.spilled();
+            }
 
             std::cout << " Progress: ";
             std::cout << std::setfill(' ') << std::setw(6) << std::setprecision(1) << std::fixed << ratio * 100 << "% | ";
@@ -952,17 +2378,87 @@ private:
    bool hasRun = true;
    bool stopRequested = false;
 
-   std::vector<std::unique_ptr<TimeFrameTree<RowReaderType, IdBranchType, TimeBranchType>>> trees;
+   std::vector<std::unique_ptr<Source>> trees;
+
+   // Declared before everything holding row handles, so it is destroyed last
+   RowArena<RowType> rowArena;
 
    std::function<bool(IdBranchType)> idFilter;
+   bool idFilterSet = false;
+
+   TimeBranchType timeFrom = std::numeric_limits<TimeBranchType>::lowest();
+   TimeBranchType timeTill = std::numeric_limits<TimeBranchType>::max();
+   TimeBranchType warmUp = 0;
+   TimeBranchType streamTime = std::numeric_limits<TimeBranchType>::lowest();
+
+   // Last row dispatched, passed to the row generators
+   bool firstMessage = true;
+   IdBranchType lastId;
+   TimeBranchType lastTime;
+   RowHandle lastRow;
 
    // === ROW GENERATORS ===
 
    std::function<std::optional<IDTimeRow>(IdBranchType, TimeBranchType, const RowType&, 
       IdBranchType, TimeBranchType, const RowType&)> checkForGeneratedRow;
+   std::function<void(IdBranchType, TimeBranchType, const RowType&,
+      IdBranchType, TimeBranchType, const RowType&, std::vector<IDTimeRow>&)> generateRows;
+   std::vector<IDTimeRow> generatedRows;
 
    // --- ROW GENERATORS ---
 
+   // === BATCH PREDICATES ===
+
+   std::function<void(const RowBlock&, SelectionMask&)> batchFilter;
+   std::function<void(const RowBlock&, SelectionMask&)> batchTrigger;
+
+   size_t batchSize = 1024;
+   RowBlock block;
+   SelectionMask filterMask;
+   SelectionMask triggerMask;
+   std::vector<char> blockFilterSelected;
+   std::vector<char> blockTriggerSelected;
+   bool passUnselectedRows = false;   // No handler needs the rows the predicates do not select
+
+   // --- BATCH PREDICATES ---
+
+   // === EXPRESSIONS ===
+
+   // Compiled for every tree when running
+   std::string selectionExpression;
+   std::string filterExpression;
+   std::string triggerExpression;
+
+   // --- EXPRESSIONS ---
+
+   // === I/O ===
+
+   IOOptions ioOptions;
+   std::map<int, IOOptions> treeIOOptions;
+
+   // --- I/O ---
+
+   // === STREAM ===
+
+   std::function<void()> preFilterCallback;
+   TimeBranchType readTill = std::numeric_limits<TimeBranchType>::max();
+   TimeBranchType streamEndTime = std::numeric_limits<TimeBranchType>::max();
+
+   int currentSource = -1;
+   bool eventRead = false;
+   StreamEvent streamEvent;
+
+   // --- STREAM ---
+
+   // === TIMELINE CACHE ===
+
+   std::string timelineCacheDirectory;
+   std::string timelineCacheKey;
+   std::string timelineCachePath;
+   std::unique_ptr<NativeWriter<RowType, IdBranchType, TimeBranchType>> timelineWriter;
+
+   // --- TIMELINE CACHE ---
+
    // === TRIGGERS ===
 
    // Trigger handlers
@@ -996,7 +2492,9 @@ private:
    // Action handlers
 
    std::function<void(IdBranchType, TimeBranchType, const RowType&, const std::list<std::pair<TimeBranchType, RowType>>&)> action;
+   std::function<void(IdBranchType, TimeBranchType, const RowType&, const RowWindow&)> actionWithRowWindow;
    std::function<void(IdBranchType, TimeBranchType, const RowType&, const StateType&, const std::list<TimeRowState>&)> actionWithState;
+   std::function<void(IdBranchType, TimeBranchType, const RowType&, const StateType&, const SpillWindow<TimeRowState>&)> actionWithStateSpilled;
    std::function<void(IdBranchType, TimeBranchType, const RowType&, const StateType&,
       const std::list<std::pair<TimeBranchType, std::map<IdBranchType, RowState>>>&)> actionWithAllState;
 
@@ -1005,9 +2503,11 @@ private:
    std::map<IdBranchType, long> actionCount;
    std::map<IdBranchType, std::list<long>> rowsIndex;
 
-   // One of 3 is used
+   // One of 5 is used
    std::map<IdBranchType, std::list<std::pair<TimeBranchType, RowType>>> rows;
+   std::map<IdBranchType, RowWindow> rowWindows;
    std::map<IdBranchType, std::list<TimeRowState>> rowStates;
+   std::map<IdBranchType, SpillWindow<TimeRowState>> rowStatesSpilled;
    std::list<std::pair<TimeBranchType, std::map<IdBranchType, RowState>>> rowAllStates;
 
    // Action config
@@ -1020,9 +2520,61 @@ private:
    bool tillBasedOnMessage = false;
    TimeBranchType resampleInterval;
    bool resampleAction = false;
+   std::string spillDirectory = "/tmp";
+   size_t spillHotRows = 1000000;
+   size_t spillSegmentRows = 65536;
 
    // --- ACTIONS ---
 
+   // === PIPELINES ===
+
+   struct Pipeline
+   {
+      std::string name;
+      TimeBranchType from = 0;
+      TimeBranchType till = 0;
+      TimeBranchType cooldown = 0;
+
+      std::function<bool(IdBranchType, TimeBranchType, const RowType&)> trigger;
+      std::function<void(IdBranchType, TimeBranchType, const RowType&, const RowWindowView&)> action;
+      std::function<void(IdBranchType, TimeBranchType, const RowType&, const RowWindow&)> actionOnCopy;
+
+      std::map<IdBranchType, TimeBranchType> lastTrigger;
+      std::map<IdBranchType, RowWindow> pending;    // Triggers waiting for the end of their window
+      long triggerCount = 0;
+   };
+
+   std::vector<Pipeline> pipelines;
+   std::map<IdBranchType, RowWindow> pipelineRows;   // Shared by all pipelines
+
+   // --- PIPELINES ---
+
+   // === TIMERS ===
+
+   TimerWheel<TimeBranchType> timerWheel;
+   bool exactActionTiming = false;
+
+   // --- TIMERS ---
+
+   // === ACTION THREADS ===
+
+   struct PendingAction
+   {
+      std::future<void> done;
+      std::shared_ptr<void> arguments;
+      std::vector<std::function<void()>> emits;
+   };
+
+   // Declared before the pool, so the arguments are only released after its threads finished
+   std::list<PendingAction> pendingActions;
+   std::unique_ptr<ThreadPool> actionPool;
+   size_t maxPendingActions = 0;
+   bool actionsOrdered = true;
+
+   static inline thread_local std::vector<std::function<void()>>* currentEmits = nullptr;
+
+   // --- ACTION THREADS ---
+
    // === STATE AND ROW HANDLERS ===
 
    std::function<StateType(IdBranchType)> stateInitializer;
@@ -1030,6 +2582,10 @@ private:
 
    std::function<void(IdBranchType, TimeBranchType, const StateType&)> forEachSnapshot;
    std::function<void(TimeBranchType, const std::map<IdBranchType, StateType>&)> forEachSnapshotAllStates;
+   std::function<void(IdBranchType, TimeBranchType, const StateType&)> forEachChangedSnapshot;
+   std::function<void(TimeBranchType, const std::map<IdBranchType, StateType>&, const std::vector<IdBranchType>&)> forEachChangedSnapshotAllStates;
+   std::function<void(TimeBranchType, const StateColumns&)> forEachColumnSnapshot;
+   std::vector<std::function<double(const StateType&)>> stateColumnExtractors;
 
    std::function<void(IdBranchType, TimeBranchType, const RowType&)> forEachRow;
    std::function<void(IdBranchType, TimeBranchType, const RowType&, const StateType&)> forEachRowWithState;
@@ -1039,6 +2595,13 @@ private:
 
    std::map<IdBranchType, StateType> currentStates;
    TimeNS lastWindow = 0;
+   long long rowsInRange = 0;
+
+   std::unordered_map<IdBranchType, char> changedFlags;   // Per id, set while the id is in changedIds
+   std::vector<IdBranchType> changedIds;                 // Updated since the previous snapshot, sorted at the snapshot
+
+   StateColumns stateColumns;
+   bool stateColumnsLayoutChanged = false;    // Ids or columns added since the columns were built
 
    // config
 
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+// Identifies a file by path, size and modification time, so a changed file gets a new key
+inline std::string sourceFileKey(const std::string& path)
+{
+   std::error_code error;
+   auto size = std::filesystem::file_size(path, error);
+   auto modified = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+
+   return path + "@" + std::to_string(size) + "@" + std::to_string(modified);
+}
+
+// I/O settings of a source, sources that are not ROOT trees ignore them
+struct IOOptions
+{
+   long long cacheSize = -1;        // Bytes of the TTreeCache, -1 chooses the size from the number of trees
+   int learnEntries = 100;          // Entries read before the cache decides which branches it holds
+   bool cacheAllBranches = false;   // Caches every branch right away instead of learning
+   bool statistics = false;         // Collects I/O statistics, reported after running
+};
+
+struct IOStatistics
+{
+   long long bytesRead = 0;
+   long long readCalls = 0;
+   double diskTime = 0;     // Seconds
+   double unzipTime = 0;    // Seconds
+};
+
+// Input of a TimeFrame: the rows of one or more ids in time order.
+// prepareNext moves to the next row that passes the id filter and is not before timeFrom, and caches its id and time.
+// The row itself is only read when it is dispatched.
+template<class RowType, class IdBranchType, class TimeBranchType>
+struct TimeFrameSource
+{
+   virtual ~TimeFrameSource()
+   {
+
+   }
+
+   // Expressions are compiled against ROOT branches, sources without them cannot evaluate expressions
+   virtual void setExpressions(const std::string& selectionStr, const std::string& filterStr, const std::string& triggerStr)
+   {
+      if(selectionStr.size() > 0 || filterStr.size() > 0 || triggerStr.size() > 0)
+      {
+         throw std::runtime_error("Expressions are only supported on ROOT trees");
+      }
+   }
+
+   void prepareFirst(const std::function<bool(IdBranchType)>& idFilter, const std::function<void()>& preFilterCallback)
+   {
+      prepareNext(idFilter, preFilterCallback);
+   }
+
+   virtual void prepareNext(const std::function<bool(IdBranchType)>& idFilter, const std::function<void()>& preFilterCallback) = 0;
+
+   virtual RowType readRow() = 0;
+
+   virtual long getNumberEntries() = 0;
+
+   virtual void configureIO(const IOOptions& options, int numberSources)
+   {
+
+   }
+   virtual IOStatistics getIOStatistics()
+   {
+      return IOStatistics();
+   }
+
+   // Identifies the rows the source delivers for the timeline cache, empty if they cannot be identified
+   virtual std::string getCacheKey()
+   {
+      return "";
+   }
+
+   bool hasNewRow = true;
+   IdBranchType id = IdBranchType();
+   TimeBranchType time = TimeBranchType();
+
+   // Set by expressions evaluated on the current row
+   bool filterSelected = false;
+   bool triggerSelected = false;
+
+   TimeBranchType lastTime = 0;
+   TimeBranchType timeFrom = std::numeric_limits<TimeBranchType>::lowest();
+
+   long messagesSkipped = 0;
+};
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Hierarchical timing wheel: 8 levels of 256 slots, each level covering 8 more bits of the time in ticks.
+// A timer is placed on the level of the highest byte in which its tick differs from the current tick, scheduling is O(1).
+// Advancing finds the next non empty slot through the bitmaps of the levels and moves the timers of a higher level slot
+// down when the current tick reaches it, so every timer is moved at most 7 times.
+template<class TimeType>
+class TimerWheel
+{
+public:
+   using Callback = std::function<void(TimeType)>;
+
+   // Times are counted in ticks of resolution, integral times from their lowest value, others from the first time advanced to
+   TimerWheel(TimeType resolution = 1)
+   :  resolution(resolution)
+   {
+      if constexpr (std::is_integral_v<TimeType>)
+      {
+         origin = std::numeric_limits<TimeType>::lowest();
+         started = true;
+      }
+   }
+
+   // Due once a time after it is passed to advance, or with dueAtTime once the time itself is passed.
+   // Times already passed are due at the next advance.
+   void schedule(TimeType time, Callback callback, bool dueAtTime = false)
+   {
+      timers++;
+      if(!started)
+      {
+         waiting.push_back(Timer{0, sequence++, time, dueAtTime, std::move(callback)});
+         return;
+      }
+
+      insert(Timer{std::max(toTick(time), current), sequence++, time, dueAtTime, std::move(callback)});
+   }
+
+   // Calls the callbacks of all timers due at now in time order, those of equal times in the order they were scheduled.
+   // Callbacks may schedule further timers.
+   void advance(TimeType now)
+   {
+      if(!started)
+      {
+         origin = now;
+         started = true;
+
+         for(auto& timer : waiting)
+         {
+            timer.tick = toTick(timer.time);
+            insert(std::move(timer));
+         }
+         waiting.clear();
+      }
+
+      uint64_t tick = toTick(now);
+
+      while(timers > 0)
+      {
+         int level = 0;
+         int slot = -1;
+         for(; level < Levels; level++)
+         {
+            slot = nextSlot(level, byteOf(current, level));
+            if(slot != -1)
+            {
+               break;
+            }
+         }
+         if(slot == -1)
+         {
+            break;
+         }
+
+         // Start of the slot, the bytes above the level are those of the current tick
+         uint64_t shift = 8 * level;
+         uint64_t high = level == Levels - 1 ? 0 : (current >> (shift + 8)) << (shift + 8);
+         uint64_t slotStart = high | ((uint64_t) slot << shift);
+         if(slotStart > tick)
+         {
+            break;
+         }
+
+         current = std::max(current, slotStart);
+         std::vector<Timer> due;
+         std::swap(due, slots[level][slot]);
+         clearBit(level, slot);
+
+         // The tick of now holds timers that are not due yet, their times are compared to now
+         if(level == 0 && slotStart == tick)
+         {
+            if(!fireDue(slot, due, now))
+            {
+               break;
+            }
+         }
+         else if(level == 0)
+         {
+            sortBySequence(due);
+
+            timers -= due.size();
+            for(auto& timer : due)
+            {
+               timer.callback(timer.time);
+            }
+         }
+         else
+         {
+            for(auto& timer : due)
+            {
+               insert(std::move(timer));
+            }
+         }
+      }
+
+      current = std::max(current, tick);
+   }
+
+   size_t size() const
+   {
+      return timers;
+   }
+
+private:
+   static constexpr int Levels = 8;
+   static constexpr int Slots = 256;
+
+   struct Timer
+   {
+      uint64_t tick;
+      uint64_t sequence;
+      TimeType time;
+      bool dueAtTime;
+      Callback callback;
+   };
+
+   // Timers scheduled for a time already passed come first, then those of the slot in the order they were scheduled.
+   // Timers moved down from higher levels were scheduled before those placed here directly.
+   void sortBySequence(std::vector<Timer>& due) const
+   {
+      auto before = [this](const Timer& a, const Timer& b)
+      {
+         bool aPassed = toTick(a.time) < a.tick;
+         bool bPassed = toTick(b.time) < b.tick;
+         return aPassed != bPassed ? aPassed : a.sequence < b.sequence;
+      };
+
+      if(!std::is_sorted(due.begin(), due.end(), before))
+      {
+         std::stable_sort(due.begin(), due.end(), before);
+      }
+   }
+
+   // Calls the timers of the slot of now that are due and puts the others back, false if none was due
+   bool fireDue(int slot, std::vector<Timer>& due, TimeType now)
+   {
+      sortBySequence(due);
+
+      std::vector<Timer> pending;
+      bool fired = false;
+      for(auto& timer : due)
+      {
+         if(timer.time < now || (timer.dueAtTime && timer.time == now))
+         {
+            timers--;
+            fired = true;
+            timer.callback(timer.time);
+         }
+         else
+         {
+            pending.push_back(std::move(timer));
+         }
+      }
+
+      // Timers scheduled by the callbacks into this slot come after those that were waiting
+      auto& rest = slots[0][slot];
+      pending.insert(pending.end(), std::make_move_iterator(rest.begin()), std::make_move_iterator(rest.end()));
+      rest.swap(pending);
+      if(rest.size() > 0)
+      {
+         bitmaps[0][slot / 64] |= 1ULL << (slot % 64);
+      }
+
+      return fired;
+   }
+
+   uint64_t toTick(TimeType time) const
+   {
+      if(time <= origin)
+      {
+         return 0;
+      }
+      if constexpr (std::is_integral_v<TimeType>)
+      {
+         // Unsigned, so the full range of a signed time fits
+         return ((uint64_t) time - (uint64_t) origin) / (uint64_t) resolution;
+      }
+      else
+      {
+         return (uint64_t) ((time - origin) / resolution);
+      }
+   }
+
+   static int byteOf(uint64_t tick, int level)
+   {
+      return (tick >> (8 * level)) & 0xFF;
+   }
+
+   void insert(Timer&& timer)
+   {
+      uint64_t difference = timer.tick ^ current;
+      int level = difference == 0 ? 0 : (63 - __builtin_clzll(difference)) / 8;
+      int slot = byteOf(timer.tick, level);
+
+      slots[level][slot].push_back(std::move(timer));
+      bitmaps[level][slot / 64] |= 1ULL << (slot % 64);
+   }
+
+   // First non empty slot at or after from, -1 if none
+   int nextSlot(int level, int from) const
+   {
+      for(int word = from / 64; word < Slots / 64; word++)
+      {
+         uint64_t bits = bitmaps[level][word];
+         if(word == from / 64)
+         {
+            bits &= ~0ULL << (from % 64);
+         }
+         if(bits != 0)
+         {
+            return word * 64 + __builtin_ctzll(bits);
+         }
+      }
+      return -1;
+   }
+
+   void clearBit(int level, int slot)
+   {
+      bitmaps[level][slot / 64] &= ~(1ULL << (slot % 64));
+   }
+
+   TimeType resolution;
+   TimeType origin = TimeType();
+   bool started = false;
+
+   std::vector<Timer> waiting;    // Scheduled before the origin is known
+   uint64_t current = 0;
+   uint64_t sequence = 0;
+   size_t timers = 0;
+
+   std::vector<Timer> slots[Levels][Slots];
+   uint64_t bitmaps[Levels][Slots / 64] = {};
+};
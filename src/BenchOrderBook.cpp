@@ -0,0 +1,214 @@
+#include "../include/OrderBook.h"
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+// Measures the updates per second of OrderBook under an L3 message mix like that of an equity feed:
+// most orders are added close to the touch and cancelled again, few are executed or replaced, and the price drifts.
+// The messages are generated before the clock starts, so only the book is measured.
+//
+// Example: ./BenchOrderBook.exe --messages 20000000 --adds 0.48 --cancels 0.42 --executes 0.06 --snapshot-every 100
+
+struct BenchConfig
+{
+   long long messages = 10000000;
+   unsigned long long seed = 1;
+
+   // Shares of the message types, the remainder are replaces
+   double adds = 0.48;
+   double cancels = 0.42;
+   double executes = 0.06;
+
+   double depth = 0.15;          // Distance of new orders from the touch is geometric with this success probability, in ticks
+   double drift = 0.01;          // Probability that the mid price moves per message
+   int snapshotEvery = 0;        // Reads the top levels after every n messages, 0 for never
+   int snapshotLevels = 10;
+   int window = 2048;
+};
+
+struct BenchMessage
+{
+   char type;
+   BookSide side;
+   uint64_t orderId;
+   uint64_t newOrderId;
+   double price;
+   long long quantity;
+};
+
+BenchConfig parseArguments(int argc, char** argv)
+{
+   BenchConfig config;
+
+   std::map<std::string, std::function<void(std::string)>> options = {
+      {"--messages", [&](std::string v){ config.messages = std::stoll(v); }},
+      {"--seed", [&](std::string v){ config.seed = std::stoull(v); }},
+      {"--adds", [&](std::string v){ config.adds = std::stod(v); }},
+      {"--cancels", [&](std::string v){ config.cancels = std::stod(v); }},
+      {"--executes", [&](std::string v){ config.executes = std::stod(v); }},
+      {"--depth", [&](std::string v){ config.depth = std::stod(v); }},
+      {"--drift", [&](std::string v){ config.drift = std::stod(v); }},
+      {"--snapshot-every", [&](std::string v){ config.snapshotEvery = std::stoi(v); }},
+      {"--snapshot-levels", [&](std::string v){ config.snapshotLevels = std::stoi(v); }},
+      {"--window", [&](std::string v){ config.window = std::stoi(v); }},
+   };
+
+   for(int i = 1; i < argc; i++)
+   {
+      std::string key = argv[i];
+      if(options.count(key) == 0 || i + 1 >= argc)
+      {
+         throw std::runtime_error("Unknown or incomplete option: " + key);
+      }
+      options[key](argv[++i]);
+   }
+
+   if(config.adds <= 0 || config.adds + config.cancels + config.executes > 1)
+   {
+      throw std::runtime_error("Shares of the message types need to add up to at most 1, with some adds");
+   }
+
+   return config;
+}
+
+// Messages that keep the live orders consistent, so cancels and executes always name an order in the book
+std::vector<BenchMessage> generateMessages(const BenchConfig& config)
+{
+   std::mt19937_64 rng(config.seed);
+   std::uniform_real_distribution<double> uniform(0, 1);
+   std::geometric_distribution<int> distance(config.depth);
+   std::uniform_int_distribution<long long> quantity(1, 500);
+
+   std::vector<BenchMessage> messages;
+   messages.reserve(config.messages);
+
+   std::vector<uint64_t> live;
+   std::vector<long long> liveQuantity(1, 0);
+   long long mid = 10000;
+   uint64_t nextOrderId = 1;
+
+   auto newOrder = [&](BookSide& side, double& price)
+   {
+      side = uniform(rng) < 0.5 ? BookSide::Bid : BookSide::Ask;
+      long long ticks = 1 + distance(rng);
+      price = (side == BookSide::Bid ? mid - ticks : mid + ticks) * 0.01;
+   };
+
+   while((long long) messages.size() < config.messages)
+   {
+      if(uniform(rng) < config.drift)
+      {
+         mid += uniform(rng) < 0.5 ? -1 : 1;
+      }
+
+      BenchMessage message = {};
+      double u = uniform(rng);
+      size_t pick = live.size() > 0 ? rng() % live.size() : 0;
+
+      if(u < config.adds || live.size() == 0)
+      {
+         message.type = 'A';
+         message.orderId = nextOrderId++;
+         message.quantity = quantity(rng);
+         newOrder(message.side, message.price);
+
+         live.push_back(message.orderId);
+         liveQuantity.push_back(message.quantity);
+      }
+      else if(u < config.adds + config.cancels)
+      {
+         message.type = 'D';
+         message.orderId = live[pick];
+
+         live[pick] = live.back();
+         live.pop_back();
+      }
+      else if(u < config.adds + config.cancels + config.executes)
+      {
+         message.type = 'E';
+         message.orderId = live[pick];
+         message.quantity = std::min(liveQuantity[message.orderId], quantity(rng));
+
+         liveQuantity[message.orderId] -= message.quantity;
+         if(liveQuantity[message.orderId] == 0)
+         {
+            live[pick] = live.back();
+            live.pop_back();
+         }
+      }
+      else
+      {
+         message.type = 'U';
+         message.orderId = live[pick];
+         message.newOrderId = nextOrderId++;
+         message.quantity = quantity(rng);
+         newOrder(message.side, message.price);
+
+         live[pick] = message.newOrderId;
+         liveQuantity.push_back(message.quantity);
+      }
+
+      messages.push_back(message);
+   }
+
+   return messages;
+}
+
+int main(int argc, char** argv)
+{
+   try
+   {
+      BenchConfig config = parseArguments(argc, argv);
+
+      std::vector<BenchMessage> messages = generateMessages(config);
+
+      OrderBook<> book(0.01, config.window);
+      std::vector<OrderBook<>::LevelView> bids;
+      std::vector<OrderBook<>::LevelView> asks;
+      double checksum = 0;
+
+      auto start = std::chrono::steady_clock::now();
+
+      for(long long i = 0; i < (long long) messages.size(); i++)
+      {
+         const BenchMessage& m = messages[i];
+         switch(m.type)
+         {
+            case 'A': book.addOrder(m.orderId, m.side, m.price, m.quantity); break;
+            case 'D': book.cancelOrder(m.orderId); break;
+            case 'E': book.reduceOrder(m.orderId, m.quantity); break;
+            case 'U': book.replaceOrder(m.orderId, m.newOrderId, m.price, m.quantity); break;
+         }
+
+         if(book.hasBid())
+         {
+            checksum += book.bestBid();
+         }
+
+         if(config.snapshotEvery > 0 && i % config.snapshotEvery == 0)
+         {
+            book.top(BookSide::Bid, config.snapshotLevels, bids);
+            book.top(BookSide::Ask, config.snapshotLevels, asks);
+            checksum += bids.size() + asks.size();
+         }
+      }
+
+      double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      std::cout << "Applied " << messages.size() << " messages in " << seconds << " sec (" << messages.size() / seconds / 1e6 << " M updates/s)\n";
+      std::cout << "Book: " << book.numberOrders() << " orders, " << book.numberLevels(BookSide::Bid) << " bid and "
+         << book.numberLevels(BookSide::Ask) << " ask levels, checksum " << checksum << "\n";
+   }
+   catch(std::exception& error)
+   {
+      std::cout << "Error: " << error.what() << "\n";
+      return 1;
+   }
+
+   return 0;
+}
@@ -0,0 +1,81 @@
+#include "../include/TimeFrame.h"
+
+#include <filesystem>
+
+#include "Message.h"
+
+// Checks when scheduled callbacks fire relative to the rows of the stream, exits with 1 if one fires at the wrong row.
+// A callback scheduled at a time fires before the first row at or after that time, a row at exactly the time included.
+//
+// Example: ./CheckTimers.exe
+
+struct Count
+{
+   long rows = 0;
+};
+
+int main()
+{
+   std::string path = (std::filesystem::temp_directory_path() / "CheckTimers.native").string();
+   int failures = 0;
+
+   auto expect = [&](bool ok, std::string what)
+   {
+      std::cout << (ok ? "ok     " : "FAILED ") << what << "\n";
+      failures += ok ? 0 : 1;
+   };
+
+   try
+   {
+      {
+         NativeWriter<Message> writer(path);
+         for(TimeNS time : {10, 20, 30})
+         {
+            writer.push_back(1, time, Message{(double) time, 0, 0});
+         }
+         writer.close();
+      }
+
+      TimeFrame<Message, MessageReader, Count> timeFrame;
+      timeFrame.addNative(path);
+      timeFrame.setProgressBar(false);
+
+      long rows = 0;
+      timeFrame.setForEachRow([&](int id, TimeNS time, const Message& message)
+      {
+         rows++;
+      });
+
+      std::map<TimeNS, long> rowsBefore;
+      for(TimeNS time : {5, 20, 25, 30, 35})
+      {
+         timeFrame.schedule(time, [&](TimeNS t){ rowsBefore[t] = rows; });
+      }
+
+      timeFrame.run();
+
+      expect(rowsBefore.count(5) && rowsBefore[5] == 0, "time before the first row fires before it");
+      expect(rowsBefore.count(20) && rowsBefore[20] == 1, "row at exactly the time comes after the callback");
+      expect(rowsBefore.count(25) && rowsBefore[25] == 2, "time between rows fires before the next row");
+      expect(rowsBefore.count(30) && rowsBefore[30] == 2, "time of the last row fires before it");
+      expect(rowsBefore.count(35) && rowsBefore[35] == 3, "time after the last row fires at the end of the stream");
+
+      // Without dueAtTime a timer is only due once its time is passed, as the ends of action windows that include their end
+      TimerWheel<TimeNS> wheel;
+      bool fired = false;
+      wheel.schedule(100, [&](TimeNS t){ fired = true; });
+      wheel.advance(100);
+      expect(!fired, "timer not due at its own time");
+      wheel.advance(101);
+      expect(fired, "timer due after its time");
+   }
+   catch(std::exception& error)
+   {
+      std::cout << "Error: " << error.what() << "\n";
+      failures++;
+   }
+
+   std::filesystem::remove(path);
+
+   return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,99 @@
+#include "../include/TimeFrame.h"
+#include "../include/TChainFactory.h"
+
+#include <chrono>
+
+#include "Message.h"
+
+// Converts the message files of a directory into one native file and reads it back once to report the throughput.
+// Every file is a source of its own, so files covering the same time span are merged by time instead of concatenated.
+//
+// Example: ./ConvertNative.exe examples/ ".*Message.*" examples/messages.native
+
+struct Count
+{
+   long rows = 0;
+};
+
+int main(int argc, char** argv)
+{
+   if(argc < 4)
+   {
+      std::cout << "Usage: " << argv[0] << " <directory> <regex> <output> [tree]\n";
+      return 1;
+   }
+
+   std::string treeName = argc > 4 ? argv[4] : "messages";
+
+   try
+   {
+      std::vector<std::string> files = findFiles(argv[1], argv[2]);
+      if(files.size() == 0)
+      {
+         throw std::runtime_error("No files found");
+      }
+
+      auto start = std::chrono::steady_clock::now();
+
+      TimeFrame<Message, MessageReader, Count> merge;
+      for(auto& file : files)
+      {
+         TChain* chain = new TChain(treeName.c_str());
+         chain->Add(file.c_str());
+         merge.add(chain);
+      }
+      merge.setProgressBar(false);
+
+      NativeWriter<Message> writer(argv[3]);
+      merge.setForEachRow([&](int id, TimeNS time, const Message& message)
+      {
+         writer.push_back(id, time, message);
+      });
+
+      // run() has printed the error, the writer only closes the removed file
+      if(!merge.run())
+      {
+         std::remove(argv[3]);
+         return 1;
+      }
+      writer.close();
+      auto converted = std::chrono::steady_clock::now();
+
+      if(merge.getMessagesSkipped() > 0)
+      {
+         std::remove(argv[3]);
+         throw std::runtime_error(std::to_string(merge.getMessagesSkipped()) + " rows out of order within their file");
+      }
+
+      std::cout << "Converted " << writer.getRowsWritten() << " rows of " << files.size() << " files in "
+         << std::chrono::duration<double>(converted - start).count() << " sec\n";
+
+      TimeFrame<Message, MessageReader, Count> timeFrame;
+      timeFrame.addNative(argv[3]);
+      timeFrame.setProgressBar(false);
+
+      double sum = 0;
+      timeFrame.setForEachRow([&](int id, TimeNS time, const Message& message)
+      {
+         sum += message.x;
+      });
+
+      if(!timeFrame.run())
+      {
+         std::remove(argv[3]);
+         return 1;
+      }
+      auto read = std::chrono::steady_clock::now();
+
+      double seconds = std::chrono::duration<double>(read - converted).count();
+      std::cout << "Read " << timeFrame.getEntriesProcessed() << " rows in " << seconds << " sec ("
+         << (timeFrame.getEntriesProcessed() * sizeof(Message)) / seconds / 1e6 << " MB/s of rows), checksum " << sum << "\n";
+   }
+   catch(std::exception& error)
+   {
+      std::cout << "Error: " << error.what() << "\n";
+      return 1;
+   }
+
+   return 0;
+}
@@ -0,0 +1,338 @@
+#include "TFile.h"
+#include "TTree.h"
+#include "TROOT.h"
+
+#include <atomic>
+#include <cmath>
+#include <filesystem>
+#include <functional>
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../include/TimeNS.h"
+
+// Generates synthetic message files in the layout of MakeTTree (time, id, x, y, z) at scale.
+// Files are written in parallel, every file holds several ids, and every id has its own arrival process.
+// All randomness derives from the seed and the file number, so a data set is reproducible
+// independent of the number of threads.
+//
+// Files are written to generated/ by default, apart from the checked in examples.
+//
+// Example: ./Generate.exe --files 64 --ids 50 --rows 1000000000 --process hawkes --out-of-order 0.001 --threads 16
+
+struct GeneratorConfig
+{
+   int files = 3;
+   int ids = 1;
+   long long rows = 300000;
+   int threads = std::max(1u, std::thread::hardware_concurrency());
+   unsigned long long seed = 1;
+
+   std::string process = "poisson";
+   double rate = 1.0;              // Mean arrivals per second per id
+   double branching = 0.5;         // Hawkes: expected number of children per arrival (< 1)
+   double decay = 10.0;            // Hawkes: decay of the excitation per second
+   double seasonality = 3.0;       // Seasonal: intensity at the open and close relative to midday (> 0)
+
+   double outOfOrderRate = 0.0;
+   double outOfOrderDelay = 1.0;   // Maximum delay in seconds of an out of order row
+
+   std::string start = "20200101";
+   int compression = 101;          // ROOT compression settings: algorithm * 100 + level
+   int basketSize = 32000;
+   long long autoFlush = -30000000;
+
+   std::string out = "generated/";
+   std::string prefix = "Message_Of_Product_";
+};
+
+// Arrival times of a single id, sampled by thinning where the intensity varies
+class ArrivalProcess
+{
+public:
+   ArrivalProcess(const GeneratorConfig& config, TimeNS start)
+   :  config(config), time(start)
+   {
+      if(config.process == "poisson")
+      {
+         kind = Poisson;
+      }
+      else if(config.process == "hawkes")
+      {
+         kind = Hawkes;
+      }
+      else if(config.process == "seasonal")
+      {
+         kind = Seasonal;
+      }
+      else
+      {
+         throw std::runtime_error("Unknown arrival process: " + config.process);
+      }
+
+      if(kind == Hawkes && config.branching >= 1)
+      {
+         throw std::runtime_error("Hawkes process needs a branching ratio below 1");
+      }
+
+      // A Hawkes process with base rate mu has mean rate mu / (1 - branching)
+      baseRate = kind == Hawkes ? config.rate * (1 - config.branching) : config.rate;
+   }
+
+   TimeNS next(std::mt19937_64& rng)
+   {
+      if(kind == Poisson)
+      {
+         time += toNS(exponential(rng, baseRate));
+      }
+      else if(kind == Hawkes)
+      {
+         // Ogata thinning: the intensity only decays until the next arrival, so the current one is an upper bound
+         while(true)
+         {
+            double upper = baseRate + excitation;
+            double wait = exponential(rng, upper);
+
+            excitation *= std::exp(-config.decay * wait);
+            time += toNS(wait);
+
+            if(uniform(rng) * upper <= baseRate + excitation)
+            {
+               excitation += config.branching * config.decay;
+               break;
+            }
+         }
+      }
+      else
+      {
+         // The intensity peaks at midnight for a seasonality above 1 and at midday below
+         double upper = baseRate * std::max(1.0, config.seasonality);
+         while(true)
+         {
+            time += toNS(exponential(rng, upper));
+            if(uniform(rng) * upper <= baseRate * intraday(time))
+            {
+               break;
+            }
+         }
+      }
+
+      return time;
+   }
+
+private:
+   enum Kind { Poisson, Hawkes, Seasonal };
+
+   // U shaped activity over the day, equal to the seasonality at midnight and 1 at midday
+   double intraday(TimeNS t)
+   {
+      double h = (double) (t % T_Day) / T_Day * 2 - 1;
+      return 1 + (config.seasonality - 1) * h * h;
+   }
+
+   double exponential(std::mt19937_64& rng, double lambda)
+   {
+      return -std::log(1 - uniform(rng)) / lambda;
+   }
+
+   double uniform(std::mt19937_64& rng)
+   {
+      return std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+   }
+
+   TimeNS toNS(double seconds)
+   {
+      return std::max<TimeNS>(1, (TimeNS)(seconds * T_Second));
+   }
+
+   const GeneratorConfig& config;
+   Kind kind;
+   TimeNS time;
+
+   double baseRate;
+   double excitation = 0;
+};
+
+void generateFile(const GeneratorConfig& config, int fileNumber, long long rows)
+{
+   std::seed_seq seq{config.seed, (unsigned long long) fileNumber};
+   std::mt19937_64 rng(seq);
+
+   TimeNS time = 0;
+   int id;
+   double x = 0, y = 0, z = 0;
+
+   auto fileName = config.out + config.prefix + std::to_string(fileNumber + 1) + ".root";
+   TFile file(fileName.c_str(), "RECREATE", "", config.compression);
+   if(file.IsZombie())
+   {
+      throw std::runtime_error("Cannot create " + fileName);
+   }
+
+   // Owned by the file, deleted when it is closed
+   TTree* tree = new TTree("messages", "");
+
+   tree->Branch("time", &time, config.basketSize);
+   tree->Branch("id", &id, config.basketSize);
+   tree->Branch("x", &x, config.basketSize);
+   tree->Branch("y", &y, config.basketSize);
+   tree->Branch("z", &z, config.basketSize);
+   tree->SetAutoFlush(config.autoFlush);
+
+   TimeNS start = dateToNS(config.start);
+
+   std::vector<ArrivalProcess> processes;
+   std::priority_queue<std::pair<TimeNS, int>, std::vector<std::pair<TimeNS, int>>, std::greater<>> arrivals;
+   for(int i=0;i<config.ids;i++)
+   {
+      processes.emplace_back(config, start);
+      arrivals.emplace(processes[i].next(rng), i);
+   }
+
+   std::uniform_real_distribution<double> xGenerator(0.0, 1.0);
+   std::uniform_real_distribution<double> yGenerator(0.0, 10.0);
+   std::uniform_real_distribution<double> zGenerator(0.0, 100.0);
+   std::uniform_real_distribution<double> outOfOrder(0.0, 1.0);
+
+   for(long long i = 0; i < rows; i++)
+   {
+      auto [arrival, index] = arrivals.top();
+      arrivals.pop();
+      arrivals.emplace(processes[index].next(rng), index);
+
+      time = arrival;
+      if(config.outOfOrderRate > 0 && outOfOrder(rng) < config.outOfOrderRate)
+      {
+         time -= (TimeNS)(outOfOrder(rng) * config.outOfOrderDelay * T_Second);
+      }
+
+      id = fileNumber * config.ids + index + 1;
+
+      x = id + xGenerator(rng);
+      y = id / yGenerator(rng);
+      z = id * zGenerator(rng);
+
+      tree->Fill();
+   }
+
+   file.Write();
+   file.Close();
+}
+
+GeneratorConfig parseArguments(int argc, char** argv)
+{
+   GeneratorConfig config;
+
+   std::map<std::string, std::function<void(std::string)>> options = {
+      {"--files", [&](std::string v){ config.files = std::stoi(v); }},
+      {"--ids", [&](std::string v){ config.ids = std::stoi(v); }},
+      {"--rows", [&](std::string v){ config.rows = std::stoll(v); }},
+      {"--threads", [&](std::string v){ config.threads = std::stoi(v); }},
+      {"--seed", [&](std::string v){ config.seed = std::stoull(v); }},
+      {"--process", [&](std::string v){ config.process = v; }},
+      {"--rate", [&](std::string v){ config.rate = std::stod(v); }},
+      {"--branching", [&](std::string v){ config.branching = std::stod(v); }},
+      {"--decay", [&](std::string v){ config.decay = std::stod(v); }},
+      {"--seasonality", [&](std::string v){ config.seasonality = std::stod(v); }},
+      {"--out-of-order", [&](std::string v){ config.outOfOrderRate = std::stod(v); }},
+      {"--out-of-order-delay", [&](std::string v){ config.outOfOrderDelay = std::stod(v); }},
+      {"--start", [&](std::string v){ config.start = v; }},
+      {"--compression", [&](std::string v){ config.compression = std::stoi(v); }},
+      {"--basket-size", [&](std::string v){ config.basketSize = std::stoi(v); }},
+      {"--auto-flush", [&](std::string v){ config.autoFlush = std::stoll(v); }},
+      {"--out", [&](std::string v){ config.out = v; }},
+      {"--prefix", [&](std::string v){ config.prefix = v; }},
+   };
+
+   for(int i = 1; i < argc; i++)
+   {
+      std::string key = argv[i];
+      if(options.count(key) == 0 || i + 1 >= argc)
+      {
+         throw std::runtime_error("Unknown or incomplete option: " + key);
+      }
+      options[key](argv[++i]);
+   }
+
+   if(config.files < 1 || config.ids < 1 || config.threads < 1)
+   {
+      throw std::runtime_error("Files, ids and threads need to be positive");
+   }
+   if(config.seasonality <= 0)
+   {
+      throw std::runtime_error("Seasonality needs to be positive");
+   }
+
+   return config;
+}
+
+int main(int argc, char** argv)
+{
+   try
+   {
+      GeneratorConfig config = parseArguments(argc, argv);
+      auto directory = std::filesystem::path(config.out + config.prefix).parent_path();
+      if(!directory.empty())
+      {
+         std::filesystem::create_directories(directory);
+      }
+
+      ROOT::EnableThreadSafety();
+
+      std::atomic<int> nextFile(0);
+      std::atomic<int> failures(0);
+      std::mutex outputMutex;
+      std::vector<std::thread> threads;
+
+      for(int t = 0; t < std::min(config.threads, config.files); t++)
+      {
+         threads.emplace_back([&]()
+         {
+            int fileNumber;
+            while((fileNumber = nextFile++) < config.files)
+            {
+               // Spread the remainder over the first files
+               long long rows = config.rows / config.files + (fileNumber < config.rows % config.files ? 1 : 0);
+
+               try
+               {
+                  generateFile(config, fileNumber, rows);
+
+                  std::lock_guard<std::mutex> lock(outputMutex);
+                  std::cout << "Generated file " << fileNumber + 1 << " of " << config.files << " (" << rows << " rows)\n";
+               }
+               catch(std::runtime_error& error)
+               {
+                  failures++;
+                  std::lock_guard<std::mutex> lock(outputMutex);
+                  std::cout << "Error generating file " << fileNumber + 1 << ": " << error.what() << "\n";
+               }
+            }
+         });
+      }
+
+      for(auto& thread : threads)
+      {
+         thread.join();
+      }
+
+      // A partial data set is a failure for scripts
+      if(failures > 0)
+      {
+         std::cout << failures << " of " << config.files << " files failed\n";
+         return 1;
+      }
+   }
+   catch(std::exception& error)
+   {
+      std::cout << "Error: " << error.what() << "\n";
+      return 1;
+   }
+
+   return 0;
+}
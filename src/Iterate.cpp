@@ -1,56 +1,17 @@
 #include "../include/TimeFrame.h"
 #include "../include/TChainFactory.h"
+#include "../include/OrderBook.h"
 #include <map>
 
+#include "Message.h"
 
-struct Message
+// The example messages read as L2 level updates: x picks the side, y the distance of the level from 100 and z its quantity
+void updateBook(OrderBook<>& book, const Message& message)
 {
-    double x;
-    double y;
-    double z;
-};
-
-struct MessageReader
-{
-public:
-   TTreeReaderValue<double> x;
-   TTreeReaderValue<double> y;
-   TTreeReaderValue<double> z;
-
-   MessageReader(TTreeReader& reader)
-   :  x(reader, "x"),
-      y(reader, "y"),
-      z(reader, "z")
-   {
-
-   }
-
-   Message get()
-   {
-      Message message;
-
-      message.x = *x;
-      message.y = *y;
-      message.z = *z;
-
-      return message;
-   }
-};
-
-class LimitOrderBook
-{
-public:
-    void update(TimeNS time, const Message& message)
-    {
-        sumX += message.x;
-        maxY = std::max(maxY, message.y);
-        lastZ = message.z;
-    }
-
-    double sumX = 0;
-    double maxY = 0;
-    double lastZ = 0;
-};
+    BookSide side = message.x < 0.5 ? BookSide::Bid : BookSide::Ask;
+    double price = side == BookSide::Bid ? 100 - message.y : 100 + message.y;
+    book.setLevel(side, price, (long long) message.z);
+}
 
 //void Iterate()
 int main()
@@ -59,7 +20,7 @@ int main()
     auto chain2 = makeChain("messages", "examples/", ".*2.*");
     auto chain3 = makeChain("messages", "examples/", ".*3.*");
 
-    TimeFrame<Message, MessageReader, LimitOrderBook> timeFrame;
+    TimeFrame<Message, MessageReader, OrderBook<>> timeFrame;
 
     // Multiple chains are synchronized
     timeFrame.add(chain1);
@@ -68,17 +29,22 @@ int main()
 
     timeFrame.setStateInitializer([](int id)
     {
-        return LimitOrderBook();
+        return OrderBook<>(0.01);
     });
 
-    timeFrame.setStateUpdater([](int id, TimeNS time, LimitOrderBook& lob, const Message& message)
+    timeFrame.setStateUpdater([](int id, TimeNS time, OrderBook<>& book, const Message& message)
     {
-        lob.update(time, message);
+        updateBook(book, message);
     });
 
-    timeFrame.setForEachSnapshot(T_Hour, [&](TimeNS time, const std::map<int, LimitOrderBook>& lobs)
+    timeFrame.setForEachSnapshot(T_Hour, [&](TimeNS time, const std::map<int, OrderBook<>>& books)
     {
-        std::cout << lobs.size() << " internal states tracked at " << nsToTimestamp(time) << "                                             \n";
+        std::cout << books.size() << " order books tracked at " << nsToTimestamp(time);
+        for(auto& [id, book] : books)
+        {
+            std::cout << ", id " << id << " " << book.bestBid() << " / " << book.bestAsk();
+        }
+        std::cout << "                                             \n";
     });
 
     timeFrame.run();
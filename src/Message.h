@@ -0,0 +1,37 @@
+#pragma once
+
+#include "TTreeReader.h"
+
+struct Message
+{
+    double x;
+    double y;
+    double z;
+};
+
+struct MessageReader
+{
+public:
+   TTreeReaderValue<double> x;
+   TTreeReaderValue<double> y;
+   TTreeReaderValue<double> z;
+
+   MessageReader(TTreeReader& reader)
+   :  x(reader, "x"),
+      y(reader, "y"),
+      z(reader, "z")
+   {
+
+   }
+
+   Message get()
+   {
+      Message message;
+
+      message.x = *x;
+      message.y = *y;
+      message.z = *z;
+
+      return message;
+   }
+};
@@ -0,0 +1,117 @@
+#include "../include/TimeFrame.h"
+#include "../include/TChainFactory.h"
+#include "../include/OutputSink.h"
+
+#include <memory>
+
+#include "Message.h"
+
+// Writes a snapshot record of every product for every hour into a tree through an OutputSink,
+// then reads the file back to check that every record arrived.
+//
+// Example: ./WriteSnapshots.exe examples/ ".*Message.*" snapshots.root
+
+struct Summary
+{
+   double sumX = 0;
+   long messages = 0;
+};
+
+struct SnapshotRecord
+{
+   int id;
+   TimeNS time;
+   double sumX;
+   long messages;
+};
+
+struct SnapshotRecordWriter
+{
+   SnapshotRecordWriter(TTree& tree)
+   {
+      tree.Branch("id", &id);
+      tree.Branch("time", &time);
+      tree.Branch("sumX", &sumX);
+      tree.Branch("messages", &messages);
+   }
+
+   void set(const SnapshotRecord& record)
+   {
+      id = record.id;
+      time = record.time;
+      sumX = record.sumX;
+      messages = record.messages;
+   }
+
+   int id;
+   TimeNS time;
+   double sumX;
+   long messages;
+};
+
+int main(int argc, char** argv)
+{
+   if(argc < 4)
+   {
+      std::cout << "Usage: " << argv[0] << " <directory> <regex> <output> [tree]\n";
+      return 1;
+   }
+
+   std::string treeName = argc > 4 ? argv[4] : "messages";
+
+   try
+   {
+      // Products cover the same time span, every file is a source of its own
+      TimeFrame<Message, MessageReader, Summary> timeFrame;
+      for(auto& path : findFiles(argv[1], argv[2]))
+      {
+         TChain* chain = new TChain(treeName.c_str());
+         chain->Add(path.c_str());
+         timeFrame.add(chain);
+      }
+
+      timeFrame.setStateInitializer([](int id)
+      {
+         return Summary();
+      });
+      timeFrame.setStateUpdater([](int id, TimeNS time, Summary& summary, const Message& message)
+      {
+         summary.sumX += message.x;
+         summary.messages++;
+      });
+
+      long records = 0;
+      {
+         OutputSink<SnapshotRecord, SnapshotRecordWriter> sink(argv[3], "snapshots");
+
+         timeFrame.setForEachSnapshot(T_Hour, [&](int id, TimeNS time, const Summary& summary)
+         {
+            sink.push(SnapshotRecord{id, time, summary.sumX, summary.messages});
+            records++;
+         });
+
+         if(!timeFrame.run())
+         {
+            return 1;
+         }
+         sink.close();
+      }
+
+      std::unique_ptr<TFile> file(TFile::Open(argv[3], "READ"));
+      TTree* tree = file ? file->Get<TTree>("snapshots") : nullptr;
+      long long written = tree ? tree->GetEntries() : -1;
+
+      std::cout << "Wrote " << written << " of " << records << " snapshot records to " << argv[3] << "\n";
+      if(written != records)
+      {
+         throw std::runtime_error("Snapshot records are missing in the output");
+      }
+   }
+   catch(std::exception& error)
+   {
+      std::cout << "Error: " << error.what() << "\n";
+      return 1;
+   }
+
+   return 0;
+}